@@ -0,0 +1,172 @@
+/*
+    Pluggable allocation of the triangulation nodes
+
+    The engines allocate their nodes through mesh_alloc(), which calls the
+    allocator set by set_allocator() (malloc by default). The bump arena
+    hands out consecutive pieces of large blocks: no per node bookkeeping,
+    and a whole triangulation is freed by rewinding to the first block.
+    The bump is an atomic add, so that concurrent insertion (concurrent.c)
+    can share the arena; only moving to the next block takes a lock.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "alloc.h"
+
+#define ARENA_ALIGN 16
+#define ALIGN(s) (((s) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+typedef struct arena_block_s {
+	struct arena_block_s *next;
+	size_t size;           /* Usable bytes */
+	size_t used;           /* May go past size when the block is full */
+} arena_block_t;
+
+#define BLOCK_DATA(b) ((char *)(b) + ALIGN(sizeof(arena_block_t)))
+
+struct arena_s {
+	allocator_t allocator;
+	arena_block_t *first;
+	arena_block_t *current;
+	size_t block_size;
+	pthread_mutex_t lock;
+};
+
+static void *malloc_alloc(void *state, size_t size)
+{
+	return malloc(size);
+}
+
+static void malloc_release(void *state, void *p)
+{
+	free(p);
+}
+
+static allocator_t malloc_allocator = { malloc_alloc, malloc_release, NULL };
+static allocator_t *allocator = &malloc_allocator;
+
+void set_allocator(allocator_t *a)
+{
+	allocator = (a == NULL) ? &malloc_allocator : a;
+}
+
+allocator_t *get_allocator(void)
+{
+	return allocator;
+}
+
+void *mesh_alloc(size_t size)
+{
+	return allocator->alloc(allocator->state, size);
+}
+
+void mesh_free(void *p)
+{
+	if (p != NULL) allocator->release(allocator->state, p);
+}
+
+static arena_block_t *new_block(size_t size)
+{
+	arena_block_t *b;
+
+	if ((b = (arena_block_t *)malloc(ALIGN(sizeof(arena_block_t)) + size)) == NULL)
+		return NULL;
+	b->next = NULL;
+	b->size = size;
+	b->used = 0;
+	return b;
+}
+
+/* Makes the block after b (with room for size bytes) the current one */
+static int next_block(arena_t *a, arena_block_t *b, size_t size)
+{
+	arena_block_t *n;
+	int ok = 1;
+
+	pthread_mutex_lock(&a->lock);
+	if (a->current == b) { /* Not already done by another thread */
+		n = b->next;
+		if (n == NULL || n->size < size) {
+			if ((n = new_block(size > a->block_size ? size : a->block_size)) == NULL)
+				ok = 0;
+			else {
+				n->next = b->next;
+				b->next = n;
+			}
+		}
+		if (ok) {
+			n->used = 0;
+			__sync_synchronize();
+			a->current = n;
+		}
+	}
+	pthread_mutex_unlock(&a->lock);
+	return ok;
+}
+
+static void *arena_alloc(void *state, size_t size)
+{
+	arena_t *a = (arena_t *)state;
+	arena_block_t *b;
+	size_t offset;
+
+	size = ALIGN(size);
+	for (;;) {
+		b = a->current;
+		offset = __sync_fetch_and_add(&b->used, size);
+		if (offset + size <= b->size) return BLOCK_DATA(b) + offset;
+		if (!next_block(a, b, size)) return NULL;
+	}
+}
+
+static void arena_release(void *state, void *p)
+{
+}
+
+arena_t *create_arena(size_t block_size)
+{
+	arena_t *a;
+
+	block_size = ALIGN(block_size > 0 ? block_size : 1);
+	if ((a = (arena_t *)malloc(sizeof(arena_t))) == NULL ||
+	    (a->first = new_block(block_size)) == NULL) {
+		fprintf(stderr, "Unable to allocate arena\n");
+		exit(EXIT_FAILURE);
+	}
+
+	a->allocator.alloc   = arena_alloc;
+	a->allocator.release = arena_release;
+	a->allocator.state   = a;
+	a->current    = a->first;
+	a->block_size = block_size;
+	pthread_mutex_init(&a->lock, NULL);
+
+	return a;
+}
+
+allocator_t *arena_allocator(arena_t *a)
+{
+	return &a->allocator;
+}
+
+/* The other blocks are emptied when they become current again */
+void reset_arena(arena_t *a)
+{
+	a->first->used = 0;
+	a->current = a->first;
+}
+
+void destroy_arena(arena_t *a)
+{
+	arena_block_t *b, *n;
+
+	if (a == NULL) return;
+	if (allocator == &a->allocator) allocator = &malloc_allocator;
+
+	for (b = a->first; b != NULL; b = n) {
+		n = b->next;
+		free(b);
+	}
+	pthread_mutex_destroy(&a->lock);
+	free(a);
+}
@@ -0,0 +1,29 @@
+#include <stddef.h>
+
+/* Allocator of the triangulation nodes (triangles, list elements,
+   quadedges, points). alloc returns NULL on failure, release may do
+   nothing. Both may be called by several threads at the same time */
+typedef struct {
+	void *(*alloc)(void *state, size_t size);
+	void (*release)(void *state, void *p);
+	void *state;
+} allocator_t;
+
+/* Allocator used from now on, NULL for malloc()/free() */
+void set_allocator(allocator_t *a);
+allocator_t *get_allocator(void);
+
+void *mesh_alloc(size_t size);
+void mesh_free(void *p);
+
+/* Bump arena: allocation moves a pointer, release does nothing, and
+   everything is freed at once by reset_arena() in O(1). Blocks are kept
+   for the next builds. For gb.c, collect_deleted_edges() must be called
+   before a reset, and init_delaunay() after it */
+typedef struct arena_s arena_t;
+
+/* Blocks of block_size bytes (bigger for bigger requests) */
+arena_t *create_arena(size_t block_size);
+allocator_t *arena_allocator(arena_t *a);
+void reset_arena(arena_t *a);
+void destroy_arena(arena_t *a);
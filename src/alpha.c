@@ -0,0 +1,159 @@
+/*
+    Alpha shapes (concave hulls) of a Delaunay triangulation
+
+    The alpha shape keeps the triangles whose circumradius is at most alpha.
+    Triangles are sorted once by circumradius, so that the shape for any
+    alpha is a prefix of that order, found by a binary search. Its boundary
+    is made of the edges of kept triangles whose neighbor is not kept; the
+    loops are followed by turning around the vertices through the kept
+    triangles, which also splits pinched outlines properly.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "global.h"
+#include "delaunay.h"
+#include "quadedge.h"
+#include "ctable.h"
+#include "alpha.h"
+
+typedef struct {
+	double r;
+	uint32_t t;
+} sorted_triangle_t;
+
+static void *alpha_alloc(size_t size)
+{
+	void *p;
+
+	if ((p = malloc(size)) == NULL) {
+		fprintf(stderr, "Unable to allocate alpha shape\n");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+static int compare_triangles(const void *a, const void *b)
+{
+	double ra = ((sorted_triangle_t *)a)->r, rb = ((sorted_triangle_t *)b)->r;
+
+	return (ra < rb) ? -1 : (ra > rb);
+}
+
+alpha_complex_t *create_alpha_complex(tl_elt *triangulation, point_t *cloud, int n)
+{
+	alpha_complex_t *a = (alpha_complex_t *)alpha_alloc(sizeof(alpha_complex_t));
+	sorted_triangle_t *sorted;
+	uint32_t n_t, i;
+	tl_elt *tmp;
+
+	/* Triangles of the corner table come in the order of the list, less
+	   those is_cloud_triangle() leaves out */
+	a->ct = corner_table_from_list(triangulation, cloud, n);
+	n_t = a->ct->n_triangles;
+
+	a->r     = (double *)alpha_alloc((n_t+1) * sizeof(double));
+	a->order = (uint32_t *)alpha_alloc((n_t+1) * sizeof(uint32_t));
+	a->rank  = (uint32_t *)alpha_alloc((n_t+1) * sizeof(uint32_t));
+	a->done  = (unsigned char *)alpha_alloc(3*n_t + 1);
+	sorted   = (sorted_triangle_t *)alpha_alloc((n_t+1) * sizeof(sorted_triangle_t));
+
+	for (tmp = triangulation, i = 0; tmp != NULL && i < n_t; tmp = tmp->n) {
+		if (!is_cloud_triangle(tmp->t, cloud, n)) continue;
+		a->r[i] = tmp->t->r;
+		sorted[i].r = tmp->t->r;
+		sorted[i].t = i;
+		i++;
+	}
+	qsort(sorted, n_t, sizeof(sorted_triangle_t), compare_triangles);
+
+	for (i=0; i < n_t; i++) {
+		a->order[i] = sorted[i].t;
+		a->rank[sorted[i].t] = i;
+	}
+	for (i=0; i < 3*n_t; i++) a->done[i] = 0;
+
+	free(sorted);
+	return a;
+}
+
+void destroy_alpha_complex(alpha_complex_t *a)
+{
+	if (a == NULL) return;
+
+	destroy_corner_table(a->ct);
+	free(a->r);
+	free(a->order);
+	free(a->rank);
+	free(a->done);
+	free(a);
+}
+
+uint32_t alpha_cut(alpha_complex_t *a, double alpha)
+{
+	uint32_t lo = 0, hi = a->ct->n_triangles, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo)/2;
+		if (a->r[a->order[mid]] <= alpha) lo = mid+1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+/* The edge facing corner c (of a kept triangle) is on the boundary */
+static int is_boundary(alpha_complex_t *a, uint32_t c, uint32_t cut)
+{
+	uint32_t o = a->ct->o[c];
+
+	return (o == NO_CORNER || a->rank[o/3] >= cut);
+}
+
+/* Boundary edge following the one facing c, around its end vertex */
+static uint32_t next_boundary(alpha_complex_t *a, uint32_t c, uint32_t cut)
+{
+	c = CT_NEXT(c);
+	while (!is_boundary(a, c, cut)) c = CT_NEXT(a->ct->o[c]);
+	return c;
+}
+
+alpha_loops_t *alpha_shape_loops(alpha_complex_t *a, double alpha)
+{
+	alpha_loops_t *l = (alpha_loops_t *)alpha_alloc(sizeof(alpha_loops_t));
+	corner_table_t *ct = a->ct;
+	uint32_t cut = alpha_cut(a, alpha), n_v = 0, i, k, c, e;
+
+	l->n_loops = 0;
+	l->first   = (uint32_t *)alpha_alloc((3*cut + 2) * sizeof(uint32_t));
+	l->vertex  = (uint32_t *)alpha_alloc((3*cut + 1) * sizeof(uint32_t));
+
+	for (i=0; i < cut; i++) {
+		for (k=0; k < 3; k++) {
+			c = 3*a->order[i] + k;
+			if (a->done[c] || !is_boundary(a, c, cut)) continue;
+
+			l->first[l->n_loops++] = n_v;
+			e = c;
+			do {
+				a->done[e] = 1;
+				l->vertex[n_v++] = ct->v[CT_NEXT(e)];
+				e = next_boundary(a, e, cut);
+			} while (e != c);
+		}
+	}
+	l->first[l->n_loops] = n_v;
+
+	/* Clear the marks for the next query */
+	for (i=0; i < cut; i++)
+		for (k=0; k < 3; k++) a->done[3*a->order[i] + k] = 0;
+
+	return l;
+}
+
+void destroy_alpha_loops(alpha_loops_t *l)
+{
+	if (l == NULL) return;
+
+	free(l->first);
+	free(l->vertex);
+	free(l);
+}
@@ -0,0 +1,33 @@
+/* Triangles of a Delaunay triangulation sorted by circumradius: the alpha
+   shape for any alpha is a prefix of order[] */
+typedef struct {
+	corner_table_t *ct;
+	double *r;            /* Circumradius of each triangle of ct */
+	uint32_t *order;      /* Triangles by increasing circumradius */
+	uint32_t *rank;       /* Position of each triangle in order */
+	unsigned char *done;  /* Scratch marks of the boundary walk */
+} alpha_complex_t;
+
+/* Boundary loops, in the direct order of the triangles (holes reversed): loop i is
+   vertex[first[i]] to vertex[first[i+1]-1] (indices in cloud) */
+typedef struct {
+	uint32_t n_loops;
+	uint32_t *first;
+	uint32_t *vertex;
+} alpha_loops_t;
+
+/* From create_delaunay_triangulation(), using the circumradius cached in
+   each triangle */
+alpha_complex_t *create_alpha_complex(tl_elt *triangulation, point_t *cloud, int n);
+void destroy_alpha_complex(alpha_complex_t *a);
+
+/* Number of triangles of circumradius <= alpha: they are order[0] to
+   order[result-1]. O(log n) */
+uint32_t alpha_cut(alpha_complex_t *a, double alpha);
+
+/* Outline of the alpha shape, in time linear in its number of triangles
+   (only the cut is logarithmic: sweeping k values of alpha costs k walks
+   of the shapes). Queries on the same complex must not run at the same
+   time */
+alpha_loops_t *alpha_shape_loops(alpha_complex_t *a, double alpha);
+void destroy_alpha_loops(alpha_loops_t *l);
@@ -0,0 +1,334 @@
+/*
+    Concurrent incremental insertion in the quadedge triangulation
+
+    Every worker locates its point and claims the vertices of the conflict
+    zone (the triangles whose circumcircle contains the point, plus their
+    boundary) with an atomic mark. The insertion itself (insert_point_at())
+    only touches edges whose extremities are all claimed. If a claim fails,
+    the worker drops everything it holds, backs off and retries.
+
+    A thread may read any edge having at least one extremity claimed by
+    itself: no other thread can modify it at the same time. The infinite
+    vertex is claimed like any other, so changes of the hull are serialized.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+#include "global.h"
+#include "quadedge.h"
+#include "gb.h"
+#include "concurrent.h"
+
+#define LOCK_BITS  16
+#define LOCK_SLOTS (1 << LOCK_BITS)
+#define CHUNK      64   /* Points taken at once by a worker */
+#define MAX_SPIN   1024
+
+/* Owner (worker id) of the vertices hashed to each slot, 0 if free */
+static volatile int vertex_lock[LOCK_SLOTS];
+
+typedef struct {
+	int id;
+	int *held;            /* Claimed slots (a slot appears once per claim) */
+	int n_held;
+	int max_held;
+	quadedge_t **zone;    /* Edges of the conflict zone triangles */
+	int n_zone;
+	int max_zone;
+	quadedge_t *hint;     /* Last inserted edge */
+	int retries;
+} worker_t;
+
+typedef struct {
+	point_t *cloud;
+	int n;
+	volatile int next;
+} batch_t;
+
+typedef struct {
+	worker_t w;
+	batch_t *batch;
+} worker_arg_t;
+
+static int lock_slot(point_t *p)
+{
+	size_t h = ((size_t)p >> 4) * 2654435761u;
+	return (int)((h >> 8) & (LOCK_SLOTS-1));
+}
+
+static void push_held(worker_t *w, int slot)
+{
+	if (w->n_held == w->max_held) {
+		w->max_held = w->max_held ? 2*w->max_held : 64;
+		if ((w->held = (int *)realloc(w->held, w->max_held*sizeof(int))) == NULL) {
+			fprintf(stderr, "Unable to allocate worker lock list\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	w->held[w->n_held++] = slot;
+}
+
+static int claim(worker_t *w, point_t *p)
+{
+	int slot = lock_slot(p);
+
+	if (__atomic_load_n(&vertex_lock[slot], __ATOMIC_ACQUIRE) != w->id &&
+	    !__sync_bool_compare_and_swap(&vertex_lock[slot], 0, w->id))
+		return 0;
+
+	push_held(w, slot);
+	return 1;
+}
+
+static void release(worker_t *w, point_t *p)
+{
+	int slot = lock_slot(p), i, found = -1, count = 0;
+
+	for (i=0; i < w->n_held; i++) {
+		if (w->held[i] == slot) {
+			found = i;
+			count++;
+		}
+	}
+	if (found < 0) return;
+
+	w->held[found] = w->held[--w->n_held];
+	if (count == 1) __sync_lock_release(&vertex_lock[slot]);
+}
+
+static void release_all(worker_t *w)
+{
+	int i;
+
+	for (i=0; i < w->n_held; i++)
+		if (__atomic_load_n(&vertex_lock[w->held[i]], __ATOMIC_ACQUIRE) == w->id)
+			__sync_lock_release(&vertex_lock[w->held[i]]);
+	w->n_held = 0;
+}
+
+/* Origin of an edge that may not be claimed yet */
+static point_t *peek_orig(quadedge_t *e)
+{
+	return __atomic_load_n(&e->orig, __ATOMIC_RELAXED);
+}
+
+/* Claims both extremities of e. Returns -1 if e has been deleted,
+   0 if a vertex is busy or e changed while claiming it */
+static int claim_edge(worker_t *w, quadedge_t *e)
+{
+	point_t *o = peek_orig(e), *d = peek_orig(sym(e));
+
+	if (o == NULL || d == NULL) return -1;
+	if (!claim(w, o) || !claim(w, d)) return 0;
+
+	__sync_synchronize();
+	if (peek_orig(e) != o || peek_orig(sym(e)) != d) return 0;
+	return 1;
+}
+
+/* Same walk as locate_from(), handing over the claims from edge to edge.
+   f is read before it is claimed: it is checked again once it is. The
+   other workers flip edges around the walk, which may make it cycle: past
+   WALK_LIMIT steps it gives up like a failed claim (scan_faces() would
+   read edges it does not hold) */
+static quadedge_t *claim_locate(worker_t *w, quadedge_t *e, point_t *p)
+{
+	quadedge_t *f;
+	unsigned int steps = 0;
+
+	while ((f = locate_step(e, p, ++steps)) != e) {
+		if (steps > WALK_LIMIT || claim_edge(w, f) <= 0) return NULL;
+		release(w, e->orig);
+		release(w, dest(e));
+		e = f;
+	}
+	return e;
+}
+
+/* Third vertex of the left face of e. Only needs e to be claimed */
+static point_t *apex(quadedge_t *e)
+{
+	return dest(lnext(e));
+}
+
+static int is_on_hull(quadedge_t *e)
+{
+	quadedge_t *f = e;
+
+	do {
+		if (is_infinite(dest(f))) return 1;
+		f = onext(f);
+	} while (f != e);
+	return 0;
+}
+
+static int in_zone(worker_t *w, quadedge_t *e)
+{
+	int i;
+
+	for (i=0; i < w->n_zone; i++)
+		if (w->zone[i] == e) return 1;
+	return 0;
+}
+
+static void add_to_zone(worker_t *w, quadedge_t *e)
+{
+	quadedge_t *f = e;
+
+	do {
+		if (w->n_zone == w->max_zone) {
+			w->max_zone = w->max_zone ? 2*w->max_zone : 64;
+			if ((w->zone = (quadedge_t **)realloc(w->zone, w->max_zone*sizeof(quadedge_t *))) == NULL) {
+				fprintf(stderr, "Unable to allocate conflict zone\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+		w->zone[w->n_zone++] = f;
+		f = lnext(f);
+	} while (f != e);
+}
+
+/* Claims every vertex insert_point_at(e, p) may touch. The in-circle test
+   is done exactly as in the flip loop of insert_point_at() */
+static int claim_conflict_zone(worker_t *w, quadedge_t *e, point_t *p)
+{
+	quadedge_t *f, *g;
+	point_t *v;
+	int i;
+
+	w->n_zone = 0;
+
+	/* Containing face (a ghost triangle if p is outside of the hull) */
+	f = e;
+	do {
+		if (!claim(w, dest(f))) return 0;
+		f = lnext(f);
+	} while (f != e);
+	add_to_zone(w, e);
+
+	/* Point on an edge: the face on the other side is split too */
+	if (is_on_line(e, p)) {
+		if (!claim(w, apex(sym(e)))) return 0;
+		add_to_zone(w, sym(e));
+	}
+
+	for (i=0; i < w->n_zone; i++) {
+		f = w->zone[i];
+		g = sym(f);
+		if (in_zone(w, g)) continue;
+
+		v = apex(g);
+		if (!claim(w, v)) return 0;
+		if (in_conflict(f->orig, v, dest(f), p))
+			add_to_zone(w, g);
+	}
+
+	return 1;
+}
+
+static void backoff(int retry)
+{
+	volatile int i;
+	int spin = 1 << (retry < 10 ? retry : 10);
+
+	for (i=0; i < spin && i < MAX_SPIN; i++);
+	if (retry > 4) sched_yield();
+}
+
+static void concurrent_insert(worker_t *w, point_t *p)
+{
+	quadedge_t *e = NULL, *base, *h, *f;
+	int retry = 0, r;
+
+	while (1) {
+		r = claim_edge(w, w->hint);
+		if (r < 0) {
+			release_all(w);
+			w->hint = get_hull_edge();
+			continue;
+		}
+		if (r > 0 && (e = claim_locate(w, w->hint, p)) != NULL &&
+		    claim_conflict_zone(w, e, p))
+			break;
+
+		release_all(w);
+		w->retries++;
+		backoff(retry++);
+	}
+
+	base = insert_point_at(e, p);
+	if (base != NULL) w->hint = base;
+
+	/* Only a worker holding the infinite vertex can have swapped the hull
+	   edge, and p is on the hull then: the others must not read it */
+	if (base != NULL && is_on_hull(sym(base))) {
+		h = get_hull_edge();
+		if ((f = fix_hull_edge(h, base)) != h) set_hull_edge(f);
+	}
+	release_all(w);
+}
+
+static void *worker_main(void *arg)
+{
+	worker_arg_t *a = (worker_arg_t *)arg;
+	batch_t *b = a->batch;
+	int i, first;
+
+	while ((first = __sync_fetch_and_add(&b->next, CHUNK)) < b->n) {
+		for (i=first; i < first + CHUNK && i < b->n; i++)
+			concurrent_insert(&a->w, b->cloud + i);
+	}
+
+	return NULL;
+}
+
+int insert_points_concurrent(point_t *cloud, int n, int n_threads)
+{
+	worker_arg_t *args;
+	pthread_t *threads;
+	batch_t batch;
+	int i, retries = 0;
+
+	if (n_threads < 1) n_threads = 1;
+
+	/* Until the first triangle exists, points are only buffered */
+	for (; n > 0 && get_hull_edge() == NULL; cloud++, n--)
+		insert_point(cloud);
+	if (n <= 0) return 0;
+
+	args    = (worker_arg_t *)calloc(n_threads, sizeof(worker_arg_t));
+	threads = (pthread_t *)malloc(n_threads*sizeof(pthread_t));
+	if (args == NULL || threads == NULL) {
+		fprintf(stderr, "Unable to allocate insertion workers\n");
+		exit(EXIT_FAILURE);
+	}
+
+	batch.cloud = cloud;
+	batch.n     = n;
+	batch.next  = 0;
+
+	for (i=0; i < n_threads; i++) {
+		args[i].w.id   = i+1;
+		args[i].w.hint = get_hull_edge();
+		args[i].batch  = &batch;
+		if (pthread_create(&threads[i], NULL, worker_main, &args[i]) != 0) {
+			fprintf(stderr, "Unable to start insertion worker %d\n", i);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (i=0; i < n_threads; i++) {
+		pthread_join(threads[i], NULL);
+		retries += args[i].w.retries;
+		free(args[i].w.held);
+		free(args[i].w.zone);
+	}
+
+	set_starting_edge(get_hull_edge());
+	collect_deleted_edges();
+
+	free(threads);
+	free(args);
+	return retries;
+}
@@ -0,0 +1,3 @@
+/* Inserts the n points of cloud in the quadedge triangulation (gb.c) using
+   n_threads workers. Returns the number of retries due to conflicts */
+int insert_points_concurrent(point_t *cloud, int n, int n_threads);
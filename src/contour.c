@@ -0,0 +1,275 @@
+/*
+    Contour lines (isolines) of a scalar field over a triangulation
+
+    A vertex is above a level if its value is >= level. A triangle is
+    crossed by the levels in ]min, max] of its values: with sorted levels,
+    they are a range found by two binary searches, so a single pass over
+    the triangles (shared by the workers) finds every crossing. In a
+    crossed triangle, the line enters through the edge going from below to
+    above (in direct order) and leaves through the edge going from above to
+    below, which is the entering edge of the neighbor: the segments are
+    chained through the corner table into lines, each level by one worker.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "global.h"
+#include "delaunay.h"
+#include "quadedge.h"
+#include "ctable.h"
+#include "contour.h"
+
+#define CHUNK 1024 /* Triangles taken at once by a worker */
+
+typedef struct {
+	corner_table_t *ct;
+	double *value;
+	double *levels;
+	int n_levels;
+	uint32_t *lo;           /* Levels lo[t] to hi[t]-1 cross triangle t */
+	uint32_t *hi;
+	uint32_t *seg_first;    /* Segment of triangle t at level lo[t] */
+	unsigned char *done;    /* Segment already in a line */
+	uint32_t *level_first;  /* Triangles crossed by level l are tri[level_first[l]] to */
+	uint32_t *tri;          /* tri[level_first[l+1]-1] */
+	/* Level l writes at most 2 points per segment at point[2*level_first[l]]
+	   and at most one line per segment at line_first[level_first[l]] */
+	point_t *point;
+	uint32_t *line_first;
+	unsigned char *line_closed;
+	uint32_t *n_points;
+	uint32_t *n_lines;
+	volatile int next;
+} contour_batch_t;
+
+static void *contour_alloc(size_t size)
+{
+	void *p;
+
+	if ((p = malloc(size ? size : 1)) == NULL) {
+		fprintf(stderr, "Unable to allocate contours\n");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+static void run_workers(contour_batch_t *b, void *(*worker)(void *), int n_threads)
+{
+	pthread_t *threads = (pthread_t *)contour_alloc(n_threads * sizeof(pthread_t));
+	int t;
+
+	b->next = 0;
+	for (t=0; t < n_threads; t++) {
+		if (pthread_create(&threads[t], NULL, worker, b) != 0) {
+			fprintf(stderr, "Unable to start contour worker %d\n", t);
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (t=0; t < n_threads; t++) pthread_join(threads[t], NULL);
+
+	free(threads);
+}
+
+/* Number of levels <= x */
+static uint32_t levels_below(double *levels, int n_levels, double x)
+{
+	uint32_t lo = 0, hi = (uint32_t)n_levels, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo)/2;
+		if (levels[mid] <= x) lo = mid+1;
+		else hi = mid;
+	}
+	return lo;
+}
+
+static void *range_worker(void *arg)
+{
+	contour_batch_t *b = (contour_batch_t *)arg;
+	uint32_t *v = b->ct->v, t;
+	int n = (int)b->ct->n_triangles, first;
+	double f0, f1, f2, min, max;
+
+	while ((first = __sync_fetch_and_add(&b->next, CHUNK)) < n) {
+		for (t=first; t < (uint32_t)(first + CHUNK) && t < (uint32_t)n; t++) {
+			f0 = b->value[v[3*t]]; f1 = b->value[v[3*t+1]]; f2 = b->value[v[3*t+2]];
+			min = (f0 < f1) ? f0 : f1; if (f2 < min) min = f2;
+			max = (f0 > f1) ? f0 : f1; if (f2 > max) max = f2;
+			b->lo[t] = levels_below(b->levels, b->n_levels, min);
+			b->hi[t] = levels_below(b->levels, b->n_levels, max);
+		}
+	}
+	return NULL;
+}
+
+static int is_above(contour_batch_t *b, uint32_t v, double level)
+{
+	return (b->value[v] >= level);
+}
+
+/* Corner facing the edge through which the line enters (or leaves) t */
+static uint32_t crossing_corner(contour_batch_t *b, uint32_t t, double level, int leaving)
+{
+	uint32_t *v = b->ct->v, c;
+
+	for (c=3*t; c < 3*t+2; c++)
+		if (is_above(b, v[CT_NEXT(c)], level) == leaving &&
+		    is_above(b, v[CT_PREV(c)], level) != leaving) break;
+	return c;
+}
+
+/* Point of level on the edge facing c (same result from both sides) */
+static point_t crossing_point(contour_batch_t *b, uint32_t c, double level)
+{
+	uint32_t u = b->ct->v[CT_NEXT(c)], w = b->ct->v[CT_PREV(c)], x;
+	point_t *p, *q, r;
+	double s;
+
+	if (u > w) { x = u; u = w; w = x; }
+	p = b->ct->cloud + u;
+	q = b->ct->cloud + w;
+	s = (level - b->value[u]) / (b->value[w] - b->value[u]);
+	r.x = p->x + s * (q->x - p->x);
+	r.y = p->y + s * (q->y - p->y);
+	return r;
+}
+
+static uint32_t segment(contour_batch_t *b, uint32_t t, int l)
+{
+	return b->seg_first[t] + (uint32_t)l - b->lo[t];
+}
+
+/* Line of level l through triangle t0 */
+static void trace_line(contour_batch_t *b, int l, uint32_t t0)
+{
+	uint32_t *o = b->ct->o, start = t0, t = t0, c;
+	double level = b->levels[l];
+	point_t *point = b->point + 2 * b->level_first[l];
+	uint32_t line = b->level_first[l] + b->n_lines[l];
+	int closed = 0;
+
+	/* Back to the border, or around the loop */
+	for (;;) {
+		c = crossing_corner(b, t, level, 0);
+		if (o[c] == NO_CORNER) break;
+		t = o[c] / 3;
+		if (t == t0) break;
+	}
+	start = t;
+
+	b->line_first[line] = b->n_points[l];
+	point[b->n_points[l]++] = crossing_point(b, crossing_corner(b, start, level, 0), level);
+	for (;;) {
+		b->done[segment(b, t, l)] = 1;
+		c = crossing_corner(b, t, level, 1);
+		if (o[c] != NO_CORNER && o[c] / 3 == start) {
+			closed = 1;
+			break;
+		}
+		point[b->n_points[l]++] = crossing_point(b, c, level);
+		if (o[c] == NO_CORNER) break;
+		t = o[c] / 3;
+	}
+	b->line_closed[line] = closed;
+	b->n_lines[l]++;
+}
+
+static void *line_worker(void *arg)
+{
+	contour_batch_t *b = (contour_batch_t *)arg;
+	uint32_t i, t;
+	int l;
+
+	while ((l = __sync_fetch_and_add(&b->next, 1)) < b->n_levels) {
+		b->n_points[l] = 0;
+		b->n_lines[l]  = 0;
+		for (i = b->level_first[l]; i < b->level_first[l+1]; i++) {
+			t = b->tri[i];
+			if (!b->done[segment(b, t, l)]) trace_line(b, l, t);
+		}
+	}
+	return NULL;
+}
+
+contour_t *extract_contours(corner_table_t *ct, double *value, double *levels, int n_levels,
+                            int n_threads)
+{
+	contour_t *c = (contour_t *)contour_alloc(sizeof(contour_t));
+	uint32_t n_t = ct->n_triangles, n_seg, n_points, t, i, j;
+	contour_batch_t b;
+	int l;
+
+	if (n_threads < 1) n_threads = 1;
+	if (n_levels < 0) n_levels = 0;
+
+	b.ct       = ct;
+	b.value    = value;
+	b.levels   = levels;
+	b.n_levels = n_levels;
+	b.lo = (uint32_t *)contour_alloc(n_t * sizeof(uint32_t));
+	b.hi = (uint32_t *)contour_alloc(n_t * sizeof(uint32_t));
+	run_workers(&b, range_worker, n_threads);
+
+	/* Segments of each triangle, then triangles of each level */
+	b.seg_first   = (uint32_t *)contour_alloc(n_t * sizeof(uint32_t));
+	b.level_first = (uint32_t *)contour_alloc((n_levels+1) * sizeof(uint32_t));
+	for (l=0; l <= n_levels; l++) b.level_first[l] = 0;
+	for (t=0, n_seg=0; t < n_t; t++) {
+		b.seg_first[t] = n_seg;
+		n_seg += b.hi[t] - b.lo[t];
+		for (i = b.lo[t]; i < b.hi[t]; i++) b.level_first[i+1]++;
+	}
+	for (l=0; l < n_levels; l++) b.level_first[l+1] += b.level_first[l];
+
+	b.tri      = (uint32_t *)contour_alloc(n_seg * sizeof(uint32_t));
+	b.n_points = (uint32_t *)contour_alloc(n_levels * sizeof(uint32_t));
+	b.n_lines  = (uint32_t *)contour_alloc(n_levels * sizeof(uint32_t));
+	for (l=0; l < n_levels; l++) b.n_points[l] = 0;
+	for (t=0; t < n_t; t++)
+		for (i = b.lo[t]; i < b.hi[t]; i++) b.tri[b.level_first[i] + b.n_points[i]++] = t;
+
+	b.done        = (unsigned char *)contour_alloc(n_seg);
+	b.point       = (point_t *)contour_alloc(2 * n_seg * sizeof(point_t));
+	b.line_first  = (uint32_t *)contour_alloc(n_seg * sizeof(uint32_t));
+	b.line_closed = (unsigned char *)contour_alloc(n_seg);
+	memset(b.done, 0, n_seg);
+	run_workers(&b, line_worker, n_threads);
+
+	/* Levels one after the other */
+	for (l=0, c->n_lines=0, n_points=0; l < n_levels; l++) {
+		c->n_lines += b.n_lines[l];
+		n_points   += b.n_points[l];
+	}
+	c->first  = (uint32_t *)contour_alloc((c->n_lines+1) * sizeof(uint32_t));
+	c->level  = (uint32_t *)contour_alloc(c->n_lines * sizeof(uint32_t));
+	c->closed = (unsigned char *)contour_alloc(c->n_lines);
+	c->point  = (point_t *)contour_alloc(n_points * sizeof(point_t));
+
+	for (l=0, i=0, n_points=0; l < n_levels; l++) {
+		memcpy(c->point + n_points, b.point + 2 * b.level_first[l], b.n_points[l] * sizeof(point_t));
+		for (j=0; j < b.n_lines[l]; j++, i++) {
+			c->first[i]  = n_points + b.line_first[b.level_first[l] + j];
+			c->level[i]  = (uint32_t)l;
+			c->closed[i] = b.line_closed[b.level_first[l] + j];
+		}
+		n_points += b.n_points[l];
+	}
+	c->first[c->n_lines] = n_points;
+
+	free(b.lo); free(b.hi); free(b.seg_first); free(b.done);
+	free(b.level_first); free(b.tri); free(b.point);
+	free(b.line_first); free(b.line_closed); free(b.n_points); free(b.n_lines);
+	return c;
+}
+
+void destroy_contours(contour_t *c)
+{
+	if (c == NULL) return;
+
+	free(c->first);
+	free(c->level);
+	free(c->closed);
+	free(c->point);
+	free(c);
+}
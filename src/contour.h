@@ -0,0 +1,18 @@
+/* Isolines of a scalar field given at the vertices of a corner table:
+   value[i] is the value at ct->cloud[i]. Vertices are only referred to by
+   their index, so values follow their points through the engines (see
+   remove_duplicate_values() for duplicate elimination) */
+typedef struct {
+	uint32_t n_lines;
+	uint32_t *first;        /* Line i is point[first[i]] to point[first[i+1]-1] */
+	uint32_t *level;        /* Index in levels of the level of each line */
+	unsigned char *closed;  /* The last point of the line joins the first */
+	point_t *point;
+} contour_t;
+
+/* Lines at each of the n_levels levels (sorted in increasing order), with
+   the values >= level on their right. Lines come by level; the levels are
+   shared by n_threads workers */
+contour_t *extract_contours(corner_table_t *ct, double *value, double *levels, int n_levels,
+                            int n_threads);
+void destroy_contours(contour_t *c);
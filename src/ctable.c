@@ -0,0 +1,221 @@
+/*
+    Corner table representation of a triangulation, and conversions from
+    the triangle list (delaunay.c, sweephull.c) and quadedge (gb.c) engines
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "global.h"
+#include "delaunay.h"
+#include "quadedge.h"
+#include "ctable.h"
+
+/* Pointer -> index map used during the conversions */
+typedef struct {
+	void **key;
+	uint32_t *value;
+	uint32_t size; /* Power of 2 */
+} ptr_map_t;
+
+static void *ct_alloc(size_t size)
+{
+	void *p;
+
+	if ((p = malloc(size)) == NULL) {
+		fprintf(stderr, "Unable to allocate corner table\n");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+static void init_ptr_map(ptr_map_t *m, uint32_t n)
+{
+	uint32_t i;
+
+	for (m->size = 16; m->size < 2*n; m->size *= 2);
+	m->key   = (void **)ct_alloc(m->size * sizeof(void *));
+	m->value = (uint32_t *)ct_alloc(m->size * sizeof(uint32_t));
+	for (i=0; i < m->size; i++) m->key[i] = NULL;
+}
+
+static void free_ptr_map(ptr_map_t *m)
+{
+	free(m->key);
+	free(m->value);
+}
+
+static uint32_t ptr_slot(ptr_map_t *m, void *p)
+{
+	size_t h = ((size_t)p >> 3) * 2654435761u;
+	uint32_t i = (uint32_t)(h >> 8) & (m->size-1);
+
+	while (m->key[i] != NULL && m->key[i] != p) i = (i+1) & (m->size-1);
+	return i;
+}
+
+static void ptr_map_set(ptr_map_t *m, void *p, uint32_t value)
+{
+	uint32_t i = ptr_slot(m, p);
+
+	m->key[i]   = p;
+	m->value[i] = value;
+}
+
+static uint32_t ptr_map_get(ptr_map_t *m, void *p)
+{
+	uint32_t i = ptr_slot(m, p);
+
+	return (m->key[i] == NULL) ? NO_CORNER : m->value[i];
+}
+
+corner_table_t *create_corner_table(point_t *cloud, uint32_t n_vertices, uint32_t n_triangles)
+{
+	corner_table_t *ct = (corner_table_t *)ct_alloc(sizeof(corner_table_t));
+
+	ct->cloud       = cloud;
+	ct->n_vertices  = n_vertices;
+	ct->n_triangles = n_triangles;
+	ct->v = (uint32_t *)ct_alloc(3 * (n_triangles ? n_triangles : 1) * sizeof(uint32_t));
+	ct->o = (uint32_t *)ct_alloc(3 * (n_triangles ? n_triangles : 1) * sizeof(uint32_t));
+
+	return ct;
+}
+
+void destroy_corner_table(corner_table_t *ct)
+{
+	if (ct == NULL) return;
+
+	free(ct->v);
+	free(ct->o);
+	free(ct);
+}
+
+point_t *ct_opposite_vertex(corner_table_t *ct, uint32_t c)
+{
+	if (ct->o[c] == NO_CORNER) return NULL;
+	return ct->cloud + ct->v[ct->o[c]];
+}
+
+static void add_neighbors(ct_adjacency_t *a, uint32_t *fill, uint32_t u, uint32_t v)
+{
+	a->adj[a->first[u] + fill[u]++] = v;
+	a->adj[a->first[v] + fill[v]++] = u;
+}
+
+void ct_build_adjacency(corner_table_t *ct, ct_adjacency_t *a)
+{
+	uint32_t n = ct->n_vertices, c, i, *fill;
+
+	a->first = (uint32_t *)ct_alloc((n+1) * sizeof(uint32_t));
+	fill     = (uint32_t *)ct_alloc((n ? n : 1) * sizeof(uint32_t));
+	for (i=0; i <= n; i++) a->first[i] = 0;
+
+	for (c=0; c < 3*ct->n_triangles; c++) {
+		if (!CT_EDGE_CORNER(ct, c)) continue;
+		a->first[ct->v[CT_NEXT(c)]+1]++;
+		a->first[ct->v[CT_PREV(c)]+1]++;
+	}
+	for (i=0; i < n; i++) {
+		a->first[i+1] += a->first[i];
+		fill[i] = 0;
+	}
+
+	a->adj = (uint32_t *)ct_alloc((a->first[n] ? a->first[n] : 1) * sizeof(uint32_t));
+	for (c=0; c < 3*ct->n_triangles; c++)
+		if (CT_EDGE_CORNER(ct, c)) add_neighbors(a, fill, ct->v[CT_NEXT(c)], ct->v[CT_PREV(c)]);
+
+	free(fill);
+}
+
+void ct_free_adjacency(ct_adjacency_t *a)
+{
+	free(a->first);
+	free(a->adj);
+}
+
+static int in_cloud(point_t *p, point_t *cloud, int n)
+{
+	return (p >= cloud && p < cloud + n);
+}
+
+int is_cloud_triangle(triangle_t *t, point_t *cloud, int n)
+{
+	return (t != NULL && in_cloud(t->p[0], cloud, n) && in_cloud(t->p[1], cloud, n) &&
+	        in_cloud(t->p[2], cloud, n));
+}
+
+/* Triangles having a vertex outside of cloud are left out */
+corner_table_t *corner_table_from_list(tl_elt *list, point_t *cloud, int n)
+{
+	corner_table_t *ct;
+	ptr_map_t index;
+	tl_elt *tmp;
+	triangle_t *t, *u;
+	uint32_t n_t = 0, i, j;
+	int k;
+
+	for (tmp = list; tmp != NULL; tmp = tmp->n)
+		if (is_cloud_triangle(tmp->t, cloud, n)) n_t++;
+
+	ct = create_corner_table(cloud, n, n_t);
+	init_ptr_map(&index, n_t);
+
+	for (tmp = list, i = 0; tmp != NULL; tmp = tmp->n)
+		if (is_cloud_triangle(tmp->t, cloud, n)) ptr_map_set(&index, tmp->t, i++);
+
+	for (tmp = list, i = 0; tmp != NULL; tmp = tmp->n) {
+		t = tmp->t;
+		if (!is_cloud_triangle(t, cloud, n)) continue;
+
+		for (k=0; k < 3; k++) {
+			ct->v[3*i+k] = (uint32_t)(t->p[k] - cloud);
+			ct->o[3*i+k] = NO_CORNER;
+			if (!is_cloud_triangle(u = t->t[k], cloud, n)) continue;
+
+			for (j=0; j < 3; j++)
+				if (u->t[j] == t) ct->o[3*i+k] = 3*ptr_map_get(&index, u) + j;
+		}
+		i++;
+	}
+
+	free_ptr_map(&index);
+	return ct;
+}
+
+corner_table_t *corner_table_from_quadedge(quadedge_t *start, point_t *cloud, int n)
+{
+	corner_table_t *ct;
+	ptr_map_t corner;
+	quadedge_t **edges, *e;
+	uint32_t n_faces = 0, i, c;
+	int n_edges, j, k;
+
+	edges = collect_edges(start, &n_edges);
+	init_ptr_map(&corner, n_edges);
+
+	/* Corner of each kept triangle facing each of its edges */
+	for (j=0; j < n_edges; j++) {
+		e = edges[j];
+		if (ptr_map_get(&corner, e) != NO_CORNER) continue; /* Face done */
+		if (lnext(lnext(lnext(e))) != e) continue;
+		if (!in_cloud(e->orig, cloud, n) || !in_cloud(dest(e), cloud, n) ||
+		    !in_cloud(dest(lnext(e)), cloud, n)) continue;
+
+		for (k=0; k < 3; k++, e = lnext(e))
+			ptr_map_set(&corner, lnext(e), 3*n_faces+k);
+		edges[n_faces++] = e; /* j >= n_faces: edges[] holds the faces now */
+	}
+
+	ct = create_corner_table(cloud, n, n_faces);
+	for (i=0; i < n_faces; i++) {
+		e = edges[i];
+		for (k=0; k < 3; k++, e = lnext(e)) {
+			ct->v[3*i+k] = (uint32_t)(e->orig - cloud);
+			c = ptr_map_get(&corner, sym(lnext(e)));
+			ct->o[3*i+k] = c;
+		}
+	}
+
+	free_ptr_map(&corner);
+	free(edges);
+	return ct;
+}
@@ -0,0 +1,58 @@
+#include <stdint.h>
+
+/* Compact triangulation: 24 bytes per triangle.
+
+   Corner c belongs to triangle c/3. v[c] is its vertex (index in cloud),
+   corners of a triangle are in direct order. o[c] is the corner of the
+   neighbor triangle facing the same edge (the edge opposite to c),
+   NO_CORNER on the border. Triangle c/3 is the same as triangle_t with
+   p[c%3] = cloud + v[c] and t[c%3] = triangle o[c]/3.
+
+   Only the sweep-hull builds into this layout
+   (create_sweephull_corner_table()). For the list and quadedge engines it
+   is a conversion of the finished result: their build still uses
+   triangle_t or quadedges, so the table lowers the memory kept afterwards,
+   not the peak of the build. */
+#define NO_CORNER 0xffffffffu
+
+#define CT_NEXT(c) ((c) % 3 == 2 ? (c) - 2 : (c) + 1)
+#define CT_PREV(c) ((c) % 3 == 0 ? (c) + 2 : (c) - 1)
+
+typedef struct {
+	point_t *cloud;
+	uint32_t n_vertices;
+	uint32_t n_triangles;
+	uint32_t *v;
+	uint32_t *o;
+} corner_table_t;
+
+corner_table_t *create_corner_table(point_t *cloud, uint32_t n_vertices, uint32_t n_triangles);
+void destroy_corner_table(corner_table_t *ct);
+
+/* From create_delaunay_triangulation() or create_sweephull_triangulation().
+   Triangles having a vertex outside of cloud are left out: the others keep
+   the order of the list */
+corner_table_t *corner_table_from_list(tl_elt *list, point_t *cloud, int n);
+
+/* The triangle is kept by corner_table_from_list() */
+int is_cloud_triangle(triangle_t *t, point_t *cloud, int n);
+
+/* From the quadedge triangulation (gb.c), ghost triangles are left out */
+corner_table_t *corner_table_from_quadedge(quadedge_t *start, point_t *cloud, int n);
+
+/* Neighbors of each vertex: those of vertex i are adj[first[i]] to
+   adj[first[i+1]-1] */
+typedef struct {
+	uint32_t *first;
+	uint32_t *adj;
+} ct_adjacency_t;
+
+/* Corner c stands for the edge facing it if it is on the border or
+   o[c] > c: every edge once */
+#define CT_EDGE_CORNER(ct, c) ((ct)->o[c] == NO_CORNER || (ct)->o[c] > (c))
+
+void ct_build_adjacency(corner_table_t *ct, ct_adjacency_t *a);
+void ct_free_adjacency(ct_adjacency_t *a);
+
+/* Vertex opposite to corner c across its edge, NULL on the border */
+point_t *ct_opposite_vertex(corner_table_t *ct, uint32_t c);
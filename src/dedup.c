@@ -0,0 +1,118 @@
+/*
+    Duplicate and near-duplicate point elimination
+
+    Kept points are stored in a hash grid of cells of size tolerance. A
+    point closer than tolerance to a kept point is merged into it, which
+    only needs to look at the 3x3 cells around it: O(n) on average.
+    With a tolerance of 0, only exact duplicates are merged.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "global.h"
+#include "dedup.h"
+
+typedef struct {
+	long long x;
+	long long y;
+	int head;     /* First kept point of the cell, -1 if the slot is empty */
+} cell_t;
+
+typedef struct {
+	cell_t *cells;
+	int size;     /* Power of 2 */
+	int *next;    /* Next kept point in the same cell */
+} grid_t;
+
+static void cell_of(point_t *p, double tolerance, long long *x, long long *y)
+{
+	if (tolerance > 0) {
+		*x = (long long)floor(p->x / tolerance);
+		*y = (long long)floor(p->y / tolerance);
+	}
+	else { /* Exact coordinates (+ 0.0 turns -0.0 into 0.0) */
+		double px = p->x + 0.0, py = p->y + 0.0;
+		memcpy(x, &px, sizeof(double));
+		memcpy(y, &py, sizeof(double));
+	}
+}
+
+static cell_t *find_cell(grid_t *g, long long x, long long y)
+{
+	unsigned long long h = (unsigned long long)x * 0x9E3779B97F4A7C15ULL ^
+	                       (unsigned long long)y * 0xC2B2AE3D27D4EB4FULL;
+	int i = (int)((h >> 32) & (g->size-1));
+
+	while (g->cells[i].head != -1 && (g->cells[i].x != x || g->cells[i].y != y))
+		i = (i+1) & (g->size-1);
+	return &g->cells[i];
+}
+
+static int find_kept(grid_t *g, point_t *kept, point_t *p, double tolerance)
+{
+	long long x, y, dx, dy;
+	int range = (tolerance > 0) ? 1 : 0, k;
+	double t2 = tolerance * tolerance, d;
+	cell_t *c;
+
+	cell_of(p, tolerance, &x, &y);
+	for (dx=-range; dx <= range; dx++) {
+		for (dy=-range; dy <= range; dy++) {
+			c = find_cell(g, x+dx, y+dy);
+			for (k=c->head; k != -1; k = g->next[k]) {
+				d = (kept[k].x - p->x)*(kept[k].x - p->x) + (kept[k].y - p->y)*(kept[k].y - p->y);
+				if (d < t2 || d == 0) return k; /* Strictly closer, or the same */
+			}
+		}
+	}
+	return -1;
+}
+
+int remove_duplicates(point_t *cloud, int n, double tolerance, point_t *kept, int *map)
+{
+	grid_t g;
+	cell_t *c;
+	long long x, y;
+	int i, k, n_kept = 0;
+	point_t p;
+
+	for (g.size = 16; g.size < 2*n; g.size *= 2);
+	g.cells = (cell_t *)malloc(g.size * sizeof(cell_t));
+	g.next  = (int *)malloc((n > 0 ? n : 1) * sizeof(int));
+	if (g.cells == NULL || g.next == NULL) {
+		fprintf(stderr, "Unable to allocate duplicate elimination grid\n");
+		exit(EXIT_FAILURE);
+	}
+	for (i=0; i < g.size; i++) g.cells[i].head = -1;
+
+	for (i=0; i < n; i++) {
+		p = cloud[i];
+		if ((k = find_kept(&g, kept, &p, tolerance)) == -1) {
+			k = n_kept++;
+			kept[k] = p; /* k <= i: kept may be cloud itself */
+
+			cell_of(&p, tolerance, &x, &y);
+			c = find_cell(&g, x, y);
+			c->x = x;
+			c->y = y;
+			g.next[k] = c->head;
+			c->head = k;
+		}
+		if (map != NULL) map[i] = k;
+	}
+
+	free(g.cells);
+	free(g.next);
+	return n_kept;
+}
+
+int remove_duplicate_values(double *value, int *map, int n)
+{
+	int i, n_kept = 0;
+
+	/* A point is kept the first time its index appears in map */
+	for (i=0; i < n; i++)
+		if (map[i] == n_kept) value[n_kept++] = value[i];
+	return n_kept;
+}
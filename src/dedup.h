@@ -0,0 +1,10 @@
+/* Copies to kept the points of cloud that are not closer than tolerance
+   to a previously kept point (0: exact duplicates only). kept may be cloud.
+   map[i], if map is not NULL, is the index in kept of cloud[i].
+   Returns the number of kept points */
+int remove_duplicates(point_t *cloud, int n, double tolerance, point_t *kept, int *map);
+
+/* Moves value[i] the way remove_duplicates() moved cloud[i], given its map:
+   per-vertex attributes keep following their points. Returns the number
+   of kept values */
+int remove_duplicate_values(double *value, int *map, int n);
@@ -21,11 +21,37 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <time.h>
 #include "global.h"
 #include "util.h"
 #include "delaunay.h"
+#include "quadedge.h"
+#include "alloc.h"
 
-static point_t box[4];
+/* The outside of the convex hull is made of ghost triangles: each hull edge
+   forms a triangle with this symbolic vertex (its coordinates are never
+   read). They are kept out of the triangulation, in their own list */
+static point_t infinite;
+static tl_elt *ghosts = NULL;
+
+/* Convex hull of the last triangulation, in direct order */
+static point_t **hull = NULL;
+static int n_hull = 0;
+
+static int is_ghost(triangle_t *t)
+{
+	return (t->p[0] == &infinite || t->p[1] == &infinite || t->p[2] == &infinite);
+}
+
+/* Exact sign of v_product(): the rounded one is not consistent with itself
+   once the order of the points changes, which on cocircular or collinear
+   points (grids) let a flip free a triangle still being split */
+static int exact_v_product(point_t *p0, point_t *p1, point_t *p2)
+{
+	if (is_counter_clockwise(p0, p1, p2)) return -1;
+	if (is_counter_clockwise(p0, p2, p1)) return 1;
+	return 0;
+}
 
 void update_neighborhood(triangle_t *t1, triangle_t *t2)
 {
@@ -60,16 +86,17 @@ void recompute_neighborhood(tl_elt *triangulation, triangle_t *t)
 	}
 }
 
+/* Ghost triangles have no orientation: they must be given in direct order */
 triangle_t *create_triangle(point_t *p0, point_t *p1, point_t *p2)
 {
 	triangle_t *t;
-	int i;
-	double v = v_product(p0, p1, p2);
+	int i, ghost = (p0 == &infinite || p1 == &infinite || p2 == &infinite);
+	int v = ghost ? -1 : exact_v_product(p0, p1, p2);
 	
 	if (v == 0) /* Not a true triangle */
 		return NULL;
 	
-	if ((t = (triangle_t *)malloc(sizeof(triangle_t))) == NULL ) {
+	if ((t = (triangle_t *)mesh_alloc(sizeof(triangle_t))) == NULL ) {
 		fprintf(stderr, "Unable to allocate triangle\n");
 		exit(EXIT_FAILURE);
 	}
@@ -85,7 +112,10 @@ triangle_t *create_triangle(point_t *p0, point_t *p1, point_t *p2)
 		t->p[2] = p1;
 	}
 	
-	set_circumcircle(t);
+	if (ghost)
+		t->r = -1;
+	else
+		set_circumcircle(t);
 	for (i=0; i<3; i++) t->t[i] = NULL;
 
 	return t;
@@ -126,7 +156,7 @@ tl_elt *add_triangle(tl_elt *list, triangle_t *t)
 {
 	tl_elt *new;
 	
-	if ((new = (tl_elt *)malloc(sizeof(tl_elt))) == NULL) {
+	if ((new = (tl_elt *)mesh_alloc(sizeof(tl_elt))) == NULL) {
 		fprintf(stderr, "Out of memory when trying to add triangle to list.\n");
 		exit(EXIT_FAILURE);
 	}
@@ -159,9 +189,9 @@ tl_elt *remove_elt_containing_triangle(tl_elt *list, triangle_t *t)
 		tle->p->n = tle->n;
 	}
 
-	free(t);
+	mesh_free(t);
 	tmp = tle->p;
-	free(tle);
+	mesh_free(tle);
 	
 	if (tmp == NULL) return nxt; /*We removed the first element of the list */
 	return list;
@@ -175,38 +205,75 @@ void destroy_list(tl_elt *list)
 	
 	while (tle->n != NULL) {
 		tle = tle->n;
-		free(tle->p->t);
-		free(tle->p);
+		mesh_free(tle->p->t);
+		mesh_free(tle->p);
 	} 
-	free(tle->t);
-	free(tle);
+	mesh_free(tle->t);
+	mesh_free(tle);
 }
 
-tl_elt *create_box(int w, int h) {
-	triangle_t *t[2];
-	tl_elt *list = NULL;
-	double d;
-	int i;
+/* Ghost triangles go to their own list */
+static tl_elt *keep_triangle(tl_elt *triangulation, triangle_t *t)
+{
+	if (t == NULL) return triangulation;
+	if (is_ghost(t)) {
+		ghosts = add_triangle(ghosts, t);
+		return triangulation;
+	}
+	return add_triangle(triangulation, t);
+}
 
-	for (i=0; i < 2; i++) {
-		if ((t[i] = (triangle_t *)malloc(sizeof(triangle_t))) == NULL) {
-			fprintf(stderr, "Out of memory when trying create initial box triangles.\n");
-			exit(EXIT_FAILURE);
-		}
+static tl_elt *drop_triangle(tl_elt *triangulation, triangle_t *t)
+{
+	if (is_ghost(t)) {
+		ghosts = remove_elt_containing_triangle(ghosts, t);
+		return triangulation;
 	}
+	return remove_elt_containing_triangle(triangulation, t);
+}
 
-	box[0].x = 0; box[0].y = 0; box[1].x = w; box[1].y = 0; box[2].x = 0; box[2].y = h; box[3].x = w; box[3].y = h;
-	t[0]->p[0] = &(box[0]); t[0]->p[1] = &(box[1]); t[0]->p[2] = &(box[2]);
-	t[1]->p[0] = &(box[2]); t[1]->p[1] = &(box[1]); t[1]->p[2] = &(box[3]);
-	t[0]->t[0] = t[1];      t[0]->t[1] = NULL;      t[0]->t[2] = NULL;
-	t[1]->t[0] = NULL;      t[1]->t[1] = NULL;      t[1]->t[2] = t[0];
-	t[0]->o.x = w/2; t[0]->o.y = h/2; t[1]->o.x = w/2; t[1]->o.y = h/2;
-	d = (sqrt(w*w + h*h))/2; t[0]->r = d; t[1]->r = d;
-	
-	for (i=0; i<2; i++)
-		list = add_triangle(list, t[i]);
-	
-	return list;
+static void link_triangle(tl_elt *triangulation, triangle_t *t)
+{
+	recompute_neighborhood(triangulation, t);
+	recompute_neighborhood(ghosts, t);
+}
+
+/* Points of the hull edge of a ghost triangle, the outside being at the
+   left of a->b */
+static void get_hull_edge(triangle_t *t, point_t **a, point_t **b)
+{
+	int k;
+
+	for (k=0; t->p[k] != &infinite; k++);
+	*a = t->p[(k+1)%3];
+	*b = t->p[(k+2)%3];
+}
+
+/* p is strictly in the circumcircle of t or, for a ghost triangle, outside
+   of its hull edge */
+static int is_in_conflict(triangle_t *t, point_t *p)
+{
+	point_t *a, *b;
+
+	if (!is_ghost(t)) return incircle(t->p[0], t->p[1], t->p[2], p);
+
+	get_hull_edge(t, &a, &b);
+	switch (exact_v_product(a, b, p)) {
+	case -1: return 1;
+	case 1: return 0;
+	}
+	/* On the line of the hull edge: in conflict if on the edge itself */
+	return ((p->x - a->x)*(p->x - b->x) <= 0 && (p->y - a->y)*(p->y - b->y) <= 0);
+}
+
+/* p is in t or on its boundary */
+static int is_in_triangle(point_t *p, triangle_t *t)
+{
+	int i;
+
+	for (i=0; i<3; i++)
+		if (exact_v_product(t->p[i], t->p[(i+1)%3], p) > 0) return 0;
+	return 1;
 }
 
 int find_opposite_side(triangle_t *src, triangle_t *dst)
@@ -238,13 +305,17 @@ triangle_t *get_triangle_containing_p(tl_elt *triangulation, point_t *p) {
 	triangle_t *t = NULL;
 	
 	while (t_tmp != NULL) {
-		if (check_inclusion(p, t_tmp->t)) {
+		if (is_in_triangle(p, t_tmp->t)) {
 			t = t_tmp->t;
 			break;
 		}
 		t_tmp = t_tmp->n;
 	}
 
+	/* Outside of the hull: any ghost triangle seeing p */
+	for (t_tmp = ghosts; t == NULL && t_tmp != NULL; t_tmp = t_tmp->n)
+		if (is_in_conflict(t_tmp->t, p)) t = t_tmp->t;
+
 	return t;
 }
 
@@ -268,7 +339,7 @@ tl_elt *flip_graph(tl_elt *triangulation, triangle_t *t, point_t *p) {
 	int found = 0, summit_t;
 
 	if (t == NULL) return triangulation;  /* On the edge of the graph */
-	if (euclidian_distance(p, &(t->o)) >= t->r) return triangulation; /* Point is not in the circumcenter */
+	if (!is_in_conflict(t, p)) return triangulation; /* Point is not in the circumcenter */
 	
 	/* OK p is inside t circumcenter. Find out which neighbor of t contains p */
 	for(summit_t=0; summit_t<3; summit_t++) {
@@ -283,22 +354,23 @@ tl_elt *flip_graph(tl_elt *triangulation, triangle_t *t, point_t *p) {
 	
 	t_neighbor = t->t[summit_t];
 	
-	/* OK, now we know which summits are P and opposite to P - populate both new triangles... */
+	/* OK, now we know which summits are P and opposite to P - populate both new triangles
+	   (in direct order, for the ghost ones)... */
 	t1 = create_triangle(p, t->p[summit_t], t->p[(summit_t+1)%3]);
-	t2 = create_triangle(p, t->p[summit_t], t->p[(summit_t+2)%3]);
+	t2 = create_triangle(p, t->p[(summit_t+2)%3], t->p[summit_t]);
 	/* ...add them to the triangulation.. .*/
-	if (t1 != NULL) triangulation = add_triangle(triangulation, t1);
-	if (t2 != NULL) triangulation = add_triangle(triangulation, t2);
+	triangulation = keep_triangle(triangulation, t1);
+	triangulation = keep_triangle(triangulation, t2);
 
 	/* ... remove old triangles... */
 	remove_neighborhood(t);
 	remove_neighborhood(t_neighbor);
-	triangulation = remove_elt_containing_triangle(triangulation, t);
-	triangulation = remove_elt_containing_triangle(triangulation, t_neighbor);
+	triangulation = drop_triangle(triangulation, t);
+	triangulation = drop_triangle(triangulation, t_neighbor);
 
 	/* ...recompute adjacence */
-	recompute_neighborhood(triangulation, t1);
-	recompute_neighborhood(triangulation, t2);
+	if (t1 != NULL) link_triangle(triangulation, t1);
+	if (t2 != NULL) link_triangle(triangulation, t2);
 
 	/* ... and check the neighbors of the two new triangles (opposite to p) */
 	if (t1 != NULL) triangulation = flip_graph(triangulation, t1->t[0], p);
@@ -314,7 +386,7 @@ tl_elt *split_triangle(tl_elt *triangulation, triangle_t *t, point_t *p) {
 	for (i=0; i<3; i++) {
 		triangles[i] = create_triangle(p, t->p[i], t->p[(i+1)%3]);
 		if (triangles[i] != NULL) {
-			triangulation = add_triangle(triangulation, triangles[i]);
+			triangulation = keep_triangle(triangulation, triangles[i]);
 		}
 		else { /* Colinearity detected */
 			c = (i+2)%3;
@@ -324,23 +396,23 @@ tl_elt *split_triangle(tl_elt *triangulation, triangle_t *t, point_t *p) {
 	}
 
 	remove_neighborhood(t);
-	triangulation = remove_elt_containing_triangle(triangulation, t);
+	triangulation = drop_triangle(triangulation, t);
 
 	if (cf) {
 		if (u != NULL) {
 			for (i=3; i < 6; i++) {
 				triangles[i] = create_triangle(p, u->p[i-3], u->p[(i-2)%3]);
 				if (triangles[i] != NULL) {
-					triangulation = add_triangle(triangulation, triangles[i]);
+					triangulation = keep_triangle(triangulation, triangles[i]);
 				}
 			}
 		remove_neighborhood(u);
-		triangulation = remove_elt_containing_triangle(triangulation, u);
+		triangulation = drop_triangle(triangulation, u);
 		}
 	}
 	
 	for (i=0; i < 6; i++)
-		recompute_neighborhood(triangulation, triangles[i]);
+		if (triangles[i] != NULL) link_triangle(triangulation, triangles[i]);
 	
 	for (i=0; i < 6; i++) {
 		if (triangles[i] != NULL)
@@ -354,18 +426,19 @@ void check_delaunay(tl_elt *triangulation, point_t *cloud, int n)
 {
 	tl_elt *tmp = triangulation;
 	int i, res = 0;
-	double x1, x2, df;
+	double x1, x2;
 
+	/* Same exact test as the insertion: the rounded circumcircle of the
+	   slivers along a hull is not precise enough to be compared */
 	while (tmp != NULL)
 	{
 		for (i=0; i<n; i++)
 		{
-			x1 = euclidian_distance(cloud+i, &(tmp->t->o));
-			x2 = tmp->t->r;
-			df = x2-x1;
-			if (df > 0.00000001)
+			if (is_in_conflict(tmp->t, cloud+i))
 			{
-				fprintf(stderr, "Error while checking delaunay triangulation. Point %d - distance %.12f - radius of current circle: %.12f - difference %.12f\n", i, x1, x2, df);
+				x1 = euclidian_distance(cloud+i, &(tmp->t->o));
+				x2 = tmp->t->r;
+				fprintf(stderr, "Error while checking delaunay triangulation. Point %d - distance %.12f - radius of current circle: %.12f\n", i, x1, x2);
 				res = 1;
 			}
 		}
@@ -380,105 +453,159 @@ void check_delaunay(tl_elt *triangulation, point_t *cloud, int n)
 	}			
 }
 
-/* Return the  number of points of t in the enclosing box. s contains the number of the first summit 
-	in direct direction */
-int number_of_points_in_box(triangle_t *t, int w, int h, int *s) {
-	int i, sum = 0, summit=0;
-	double x, y;
-	
-	for (i=0; i<3; i++)
-	{
-		x = t->p[i]->x; y = t->p[i]->y;
-		if ( ((x == 0) || (x == w)) && ((y == 0) || (y == h)) ) {
-			sum++;
-			summit = i;
-		}
-	}
-	
-	if (sum == 1) *s = summit;
-	if (sum == 2) {
-		x = t->p[1]->x; y = t->p[1]->y;
-		if ( ((x == 0) || (x == w)) && ((y == 0) || (y == h)) ) {
-			*s = summit-1;
-		}
-		else {
-			*s = 2;
-		}
+/* First triangle, made of three non collinear points of cloud, with its
+   three ghost triangles. NULL if all the points are on a line */
+static tl_elt *start_triangulation(point_t *cloud, int n, int *seed)
+{
+	tl_elt *triangulation = NULL, *tmp;
+	triangle_t *t, *g;
+	int k;
+
+	seed[0] = 0;
+	for (seed[1]=1; seed[1] < n; seed[1]++)
+		if (cloud[seed[1]].x != cloud[0].x || cloud[seed[1]].y != cloud[0].y) break;
+	for (seed[2]=seed[1]+1; seed[2] < n; seed[2]++)
+		if (exact_v_product(cloud, cloud+seed[1], cloud+seed[2]) != 0) break;
+	if (seed[2] >= n) return NULL;
+
+	t = create_triangle(cloud, cloud+seed[1], cloud+seed[2]);
+	triangulation = add_triangle(triangulation, t);
+	for (k=0; k < 3; k++) {
+		g = create_triangle(t->p[(k+1)%3], t->p[k], &infinite);
+		ghosts = add_triangle(ghosts, g);
 	}
-	return sum;
+	for (tmp = ghosts; tmp != NULL; tmp = tmp->n)
+		link_triangle(triangulation, tmp->t);
+
+	return triangulation;
 }
 
-tl_elt *remove_box(tl_elt *triangulation, int w, int h, int n) {
-	tl_elt     *t_tmp = NULL,    *to_remove_list = NULL, *t_tmpp = NULL;
-	triangle_t *t_origin = NULL, *t_current = NULL;
-	int  s, p;
-	
-	/* First find one triangle in the triangulation with only one point on the box */
-	t_tmp = triangulation;
-	while (t_tmp != NULL) {
-		p = number_of_points_in_box(t_tmp->t, w, h, &s);
-		if (p == 1) {
-			t_origin = t_tmp->t;
-			break;
-		}
-		t_tmp = t_tmp->n;
-	}
-	if (t_origin == NULL) {
-		fprintf(stderr, "Unable to find triangle with one single point in box\n");
+/* Detaches the ghost triangles from the triangulation and keeps the hull,
+   walking from ghost to ghost: O(h) */
+static void remove_ghosts(void)
+{
+	triangle_t *g, *first;
+	point_t *a, *b;
+	tl_elt *tmp;
+	int i;
+
+	n_hull = 0;
+	if (ghosts == NULL) return;
+
+	for (i=0, tmp = ghosts; tmp != NULL; tmp = tmp->n) i++;
+	if ((hull = (point_t **)realloc(hull, i * sizeof(point_t *))) == NULL) {
+		fprintf(stderr, "Unable to allocate convex hull\n");
 		exit(EXIT_FAILURE);
 	}
-	
-	to_remove_list = add_triangle(to_remove_list, t_origin);
-	t_current = t_origin->t[(s+1)%3];
-	
-	/* Next, iterate on all the triangles of the border */
-	while (t_current != t_origin) {
-		to_remove_list = add_triangle(to_remove_list, t_current);
 
-		n = number_of_points_in_box(t_current, w, h, &s);
-		t_current = t_current->t[(s+1)%3];
-		
-		if (t_current == NULL) {
-			fprintf(stderr, "Internal error while removing triangle from box\n");
-			debug_list(to_remove_list);
-			exit(EXIT_FAILURE);
-		}
-	}
-	
-	/* Cleanup */
-	t_tmp = to_remove_list;
-	while (t_tmp != NULL) {
-		remove_neighborhood(t_tmp->t);
-		t_tmp = t_tmp->n;
-	}
+	first = g = ghosts->t;
+	do {
+		get_hull_edge(g, &a, &b);
+		hull[n_hull++] = b;
+		for (i=0; g->p[i] != b; i++);
+		g = g->t[i];
+	} while (g != first);
+
+	for (tmp = ghosts; tmp != NULL; tmp = tmp->n)
+		remove_neighborhood(tmp->t);
+	destroy_list(ghosts);
+	ghosts = NULL;
+}
 
-	t_tmp = to_remove_list;
-	while (t_tmp != NULL) {
-		triangulation = remove_elt_containing_triangle(triangulation, t_tmp->t);
-		t_tmpp = t_tmp;
-		t_tmp = t_tmp->n;
-		free(t_tmpp);
+int get_convex_hull(point_t **h)
+{
+	int i;
+
+	for (i=0; i < n_hull; i++) h[i] = hull[i];
+	return n_hull;
+}
+
+struct delaunay_build_s {
+	point_t *cloud;
+	int n;
+	int next;       /* Next point of cloud to insert */
+	int seed[3];
+	tl_elt *triangulation;
+};
+
+#define CLOCK_PERIOD 32 /* Points inserted between two looks at the clock */
+
+delaunay_build_t *start_delaunay_build(point_t *cloud, int n)
+{
+	delaunay_build_t *b;
+
+	if ((b = (delaunay_build_t *)malloc(sizeof(delaunay_build_t))) == NULL) {
+		fprintf(stderr, "Unable to allocate triangulation build\n");
+		exit(EXIT_FAILURE);
 	}
 
-	return triangulation;
+	destroy_list(ghosts);
+	ghosts = NULL;
+	n_hull = 0;
+
+	b->cloud = cloud;
+	b->n     = n;
+	b->next  = 0;
+	if ((b->triangulation = start_triangulation(cloud, n, b->seed)) == NULL)
+		b->next = n; /* All points collinear: nothing to do */
+
+	return b;
 }
 
-tl_elt *create_delaunay_triangulation(point_t *cloud, int n, int w, int h) {
-	tl_elt *triangulation = NULL;
+int continue_delaunay_build(delaunay_build_t *b, int max_points, double max_seconds)
+{
+	clock_t end = clock() + (clock_t)(max_seconds * CLOCKS_PER_SEC);
 	triangle_t *t_tmp;
 	point_t *p;
-	int i;
-	
-	triangulation = create_box(w, h);
-	for (i=0; i <n; i++) {
-		p = cloud+i;
-		t_tmp = get_triangle_containing_p(triangulation, p);
+	int i, inserted = 0;
+
+	for (i = b->next; i < b->n; i++) {
+		if (max_points > 0 && inserted == max_points) break;
+		if (max_seconds > 0 && inserted % CLOCK_PERIOD == CLOCK_PERIOD-1 && clock() >= end) break;
+		if (i == b->seed[0] || i == b->seed[1] || i == b->seed[2]) continue;
+		p = b->cloud+i;
+		t_tmp = get_triangle_containing_p(b->triangulation, p);
 		if (t_tmp == NULL) {
 			fprintf(stderr, "Unable to find a triangle in the triangulation containing p (0x%08x, %f, %f)\n", (int)p, p->x, p->y);
 			exit(EXIT_FAILURE);
 		}
-		triangulation = split_triangle(triangulation, t_tmp, p);
+		b->triangulation = split_triangle(b->triangulation, t_tmp, p);
+		inserted++;
 	}
-	check_delaunay(triangulation, cloud, n);
+	b->next = i;
+
+	return b->n - b->next;
+}
+
+tl_elt *get_build_triangulation(delaunay_build_t *b)
+{
+	return b->triangulation;
+}
+
+tl_elt *finish_delaunay_build(delaunay_build_t *b)
+{
+	tl_elt *triangulation;
+
+	continue_delaunay_build(b, 0, 0);
+	triangulation = b->triangulation;
+	if (triangulation != NULL) {
+		remove_ghosts();
+		check_delaunay(triangulation, b->cloud, b->n);
+	}
+
+	free(b);
 	return triangulation;
 }
+
+void cancel_delaunay_build(delaunay_build_t *b)
+{
+	destroy_list(b->triangulation);
+	destroy_list(ghosts);
+	ghosts = NULL;
+	n_hull = 0;
+	free(b);
+}
+
+tl_elt *create_delaunay_triangulation(point_t *cloud, int n) {
+	return finish_delaunay_build(start_delaunay_build(cloud, n));
+}
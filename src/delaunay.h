@@ -1,11 +1,38 @@
-struct triangle_list_elt_s {
-	struct triangle_list_elt_s *p;
-	struct triangle_list_elt_s *n;
-	triangle_t *t;
-};
-typedef struct triangle_list_elt_s tl_elt;
-
-tl_elt *create_triangulation(point_t *cloud, int n, int w, int h);
-tl_elt *create_delaunay_triangulation(point_t *cloud, int n, int w, int h);
-void destroy_list(tl_elt *list);
-
+struct triangle_list_elt_s {
+	struct triangle_list_elt_s *p;
+	struct triangle_list_elt_s *n;
+	triangle_t *t;
+};
+typedef struct triangle_list_elt_s tl_elt;
+
+tl_elt *add_triangle(tl_elt *list, triangle_t *t);
+tl_elt *create_triangulation(point_t *cloud, int n, int w, int h);
+tl_elt *create_delaunay_triangulation(point_t *cloud, int n);
+void destroy_list(tl_elt *list);
+
+/* Convex hull of the last triangulation created, in direct order. h must
+   hold all the points */
+int get_convex_hull(point_t **h);
+
+
+/* Build in slices: the points are inserted in the order of cloud, as by
+   create_delaunay_triangulation(). Only one build at a time */
+typedef struct delaunay_build_s delaunay_build_t;
+
+delaunay_build_t *start_delaunay_build(point_t *cloud, int n);
+
+/* Inserts points until max_points are inserted or max_seconds (processor
+   time) are spent, no limit if <= 0. Returns the number of points left */
+int continue_delaunay_build(delaunay_build_t *b, int max_points, double max_seconds);
+
+/* Triangulation of the points inserted so far (NULL if all the points are
+   collinear). Until the build is finished, the neighbors across the hull
+   are ghost triangles, having a vertex outside of cloud */
+tl_elt *get_build_triangulation(delaunay_build_t *b);
+
+/* Inserts the points left and frees b. Same result as
+   create_delaunay_triangulation() */
+tl_elt *finish_delaunay_build(delaunay_build_t *b);
+
+/* Frees b and the triangles built so far */
+void cancel_delaunay_build(delaunay_build_t *b);
@@ -2,27 +2,26 @@
 #include <stdio.h>
 #include "global.h"
 #include "quadedge.h"
+#include "gb.h"
+#include "alloc.h"
+
+/* The outside of the convex hull is made of ghost triangles: each hull edge
+   is connected to this symbolic vertex (its coordinates are never read) */
+static point_t infinite;
 
 static quadedge_t *starting_edge = NULL;
+static quadedge_t *hull_edge     = NULL; /* Goes out of the infinite vertex */
 static quadedge_t *delaunay_list = NULL;
 
-typedef struct {
-	int minx;
-	int miny;
-	int maxx;
-	int maxy;
-	point_t *a; /* Lower left */
-	point_t *b; /* Lower right */
-	point_t *c; /* Upper right */
-	point_t *d; /* Upper left */
-} bounding_box_t; 
-
-static bounding_box_t bbox;
+/* Points received before the first three non collinear ones */
+static point_t **pending = NULL;
+static int n_pending = 0;
+static int max_pending = 0;
 
 point_t *new_point(int x, int y) {
 	point_t *p;
 
-	if ( (p = (point_t *)malloc(sizeof(point_t))) == NULL ) {
+	if ( (p = (point_t *)mesh_alloc(sizeof(point_t))) == NULL ) {
 		fprintf(stderr, "Unable to allocate point.\n");
 		exit(EXIT_FAILURE);
 	}
@@ -33,88 +32,161 @@ point_t *new_point(int x, int y) {
 	return p;
 }
 
-#define MAX_VALUE 10000
-#define MIN_VALUE -10000
+int is_infinite(point_t *p) {
+	return (p == &infinite);
+}
+
+static point_t *apex(quadedge_t *e) {
+	return dest(lnext(e));
+}
 
-void init_bounding_box(void) {
-	bbox.minx = MAX_VALUE;
-	bbox.maxx = MIN_VALUE;
-	bbox.miny = MAX_VALUE;
-	bbox.maxy = MIN_VALUE;
+/* p is strictly at the left of a->b, or strictly between a and b */
+static int is_outside_hull_edge(point_t *a, point_t *b, point_t *p) {
+	if (is_counter_clockwise(a, b, p)) return 1;
+	if (is_counter_clockwise(b, a, p)) return 0;
+	return ((p->x - a->x)*(p->x - b->x) + (p->y - a->y)*(p->y - b->y) < 0);
+}
 
-	bbox.a = NULL;
-	bbox.b = NULL;
-	bbox.c = NULL;
-	bbox.d = NULL;
+int in_conflict(point_t *a, point_t *b, point_t *c, point_t *p) {
+	if (is_infinite(a)) return is_outside_hull_edge(b, c, p);
+	if (is_infinite(b)) return is_outside_hull_edge(c, a, p);
+	if (is_infinite(c)) return is_outside_hull_edge(a, b, p);
+	return incircle(a, b, c, p);
 }
 
+/* Triangle a, b, c and the three ghost triangles around it */
+quadedge_t *make_triangulation(point_t *a, point_t *b, point_t *c) {
+	quadedge_t *ab, *bc, *e, *base, *first;
 
-void init_delaunay(void) {
-	init_bounding_box();
-	
-	quadedge_t *ab = make_edge(bbox.a, bbox.b);
-	quadedge_t *bc = make_edge(bbox.b, bbox.c);
-	quadedge_t *cd = make_edge(bbox.c, bbox.d);
-	quadedge_t *da = make_edge(bbox.d, bbox.a);
+	if (!is_counter_clockwise(a, b, c)) {
+		point_t *t = b; b = c; c = t;
+	}
+
+	ab = make_edge(a, b);
+	bc = make_edge(b, c);
 	splice(sym(ab), bc);
-	splice(sym(bc), cd);
-	splice(sym(cd), da);
-	splice(sym(da), ab);
+	connect_quadedge(bc, ab);
 
-	starting_edge = ab;
+	/* Outer face, split by the infinite vertex */
+	e = sym(ab);
+	base = make_edge(e->orig, &infinite);
+	splice(base, e);
+	first = base;
+	do {
+		base = connect_quadedge(e, sym(base));
+		e = oprev(base);
+	} while (lnext(e) != first);
+
+	return sym(first);
+}
+
+void init_delaunay(void) {
+	starting_edge = NULL;
+	hull_edge     = NULL;
+	n_pending     = 0;
 }
 
-void set_bounding_box(int minx, int miny, int maxx, int maxy) {
-	bbox.minx = minx; bbox.maxx = maxx;
-	bbox.miny = miny; bbox.maxy = maxy;
+int is_delaunay_started(void) {
+	return (get_hull_edge() != NULL || n_pending > 0);
+}
 
-	int centerx = (minx+maxx)/2;
-	int centery = (miny+maxy)/2;
-	int x_min = (int)((minx-centerx-1)*10+centerx);
-	int x_max = (int)((maxx-centerx+1)*10+centerx);
-	int y_min = (int)((miny-centery-1)*10+centery);
-	int y_max = (int)((maxy-centery+1)*10+centery);
+/* Atomic: concurrent.c reads it without holding the infinite vertex */
+quadedge_t *get_hull_edge(void) {
+	return __atomic_load_n(&hull_edge, __ATOMIC_ACQUIRE);
+}
 
-	bbox.a->x = x_min; bbox.a->y = y_min;
-	bbox.b->x = x_max; bbox.b->y = y_min;
-	bbox.c->x = x_max; bbox.c->y = y_max;
-	bbox.d->x = x_min; bbox.d->y = y_max;
+void set_hull_edge(quadedge_t *e) {
+	__atomic_store_n(&hull_edge, e, __ATOMIC_RELEASE);
 }
 
-#define min(a,b) (a)<(b)?(a):(b)
-#define max(a,b) (a)>(b)?(a):(b)
+quadedge_t *get_starting_edge(void) {
+	return starting_edge;
+}
 
-void update_bounding_box(point_t *p) {
-	int minx = min(bbox.minx, p->x);
-	int maxx = max(bbox.maxx, p->x);
-	int miny = min(bbox.miny, p->y);
-	int maxy = max(bbox.maxy, p->y);
-	set_bounding_box(minx, miny, maxx, maxy);
-	fprintf(stderr, "Resized bounding box: %d %d %d %d\n", minx, miny, maxx, maxy);
+void set_starting_edge(quadedge_t *e) {
+	starting_edge = e;
 }
 
-quadedge_t *locate(point_t *p) {
-	if (p->x < bbox.minx || p->x > bbox.maxx || p->y < bbox.miny || p->y > bbox.maxy) {
-		update_bounding_box(p);
+/* Hull edges are followed with the ghost triangle on their left */
+static quadedge_t *next_hull_edge(quadedge_t *e) {
+	return lnext(sym(lnext(e)));
+}
+
+static quadedge_t *prev_hull_edge(quadedge_t *e) {
+	return lprev(sym(lprev(e)));
+}
+
+/* One step of the walk from e towards p. Returns e itself when p is in the
+   left face of e (on e, inside, or outside of the hull edge e for a ghost
+   triangle). Past WALK_GUARD steps, onext and dprev are tried in random
+   order so that the walk cannot cycle */
+quadedge_t *locate_step(quadedge_t *e, point_t *p, unsigned int steps) {
+	point_t *d = dest(e);
+	quadedge_t *next[2];
+	int first;
+
+	if (is_infinite(e->orig) || is_infinite(d)) return lnext(e);
+
+	/* Duplicate point ? */
+	if ( (p->x == e->orig->x) && (p->y == e->orig->y) ) return e;
+	if ( (p->x == d->x)       && (p->y == d->y) )       return e;
+
+	if (is_at_right_of(e, p)) return sym(e);
+
+	if (is_infinite(apex(e))) {
+		if (!is_on_line(e, p)) return e;
+
+		/* On the line of a hull edge: slide along the hull */
+		if ((p->x - e->orig->x)*(d->x - e->orig->x) + (p->y - e->orig->y)*(d->y - e->orig->y) < 0)
+			return prev_hull_edge(e);
+		if ((p->x - d->x)*(e->orig->x - d->x) + (p->y - d->y)*(e->orig->y - d->y) < 0)
+			return next_hull_edge(e);
+		return e;
 	}
-	
-	quadedge_t *e = starting_edge;
-	point_t *d    = dest(e);
-
-	while(1) {
-		/* Duplicate point ? */
-		if ( (p->x == e->orig->x) && (p->y == e->orig->y) ) return e;
-		if ( (p->x == d->x)       && (p->y == d->y) )       return e;
-		
-		if (is_at_right_of(e, p))
-			e = sym(e);
-		else if (!is_at_right_of(onext(e), p))
-			e = onext(e);
-		else if (!is_at_right_of(dprev(e), p))
-			e = dprev(e);
-		else
-			return e;
+
+	next[0] = onext(e);
+	next[1] = dprev(e);
+	first = (steps > WALK_GUARD) ? walk_coin(steps) : 0;
+
+	if (!is_at_right_of(next[first], p))
+		return next[first];
+	if (!is_at_right_of(next[1-first], p))
+		return next[1-first];
+	return e;
+}
+
+/* Past WALK_LIMIT steps, whatever the branch taken (slide along the hull
+   included), the walk is given up for a scan of every edge */
+static quadedge_t *scan_faces(quadedge_t *e, point_t *p) {
+	quadedge_t **edges, *f = e;
+	int n, i;
+
+	edges = collect_edges(e, &n);
+	for (i=0; i < n; i++) {
+		if (locate_step(edges[i], p, 0) == edges[i]) {
+			f = edges[i];
+			break;
+		}
+	}
+	free(edges);
+	return f;
+}
+
+quadedge_t *locate_from(quadedge_t *e, point_t *p) {
+	unsigned int steps = 0;
+	quadedge_t *f;
+
+	while ((f = locate_step(e, p, ++steps)) != e) {
+		if (steps > WALK_LIMIT) return scan_faces(e, p);
+		e = f;
 	}
+	return e;
+}
+
+quadedge_t *locate(point_t *p) {
+	if (hull_edge == NULL) return NULL;
+	if (starting_edge == NULL || is_deleted(starting_edge)) starting_edge = hull_edge;
+	return locate_from(starting_edge, p);
 }
 
 void remove_quadedge(quadedge_t *q) {
@@ -125,12 +197,25 @@ void add_quadedge(quadedge_t *q) {
 	/* Add quadedge to the linked list */
 }
 
-void insert_point (point_t *p) {
-	quadedge_t *e = locate(p);
-	point_t *d    = dest(e);
+/* The flip loop swaps e when p is in conflict with the triangle on the
+   right of e, whose apex is x. incircle() is rounded: the swap must also
+   leave two triangles of positive area, or a near-degenerate quadrilateral
+   would be folded */
+static int is_illegal(quadedge_t *e, point_t *x, point_t *p) {
+	if (is_infinite(e->orig) || is_infinite(x) || is_infinite(dest(e)))
+		return in_conflict(e->orig, x, dest(e), p);
+	return is_at_right_of(e, x) && incircle(e->orig, x, dest(e), p) &&
+	       is_counter_clockwise(e->orig, x, p) && is_counter_clockwise(x, dest(e), p);
+}
+
+/* Inserts p in the face located by locate_from(). Returns the new edge
+   going out of the face origin to p, or NULL if p is a duplicate */
+quadedge_t *insert_point_at(quadedge_t *e, point_t *p) {
+	point_t *d = dest(e);
+	quadedge_t *base, *first;
 
-	if ( (p->x == e->orig->x) && (p->y == e->orig->y) ) return;
-	if ( (p->x == d->x)       && (p->y == d->y) )       return;
+	if ( (p->x == e->orig->x) && (p->y == e->orig->y) ) return NULL;
+	if ( (p->x == d->x)       && (p->y == d->y) )       return NULL;
 	
 	/* Point is on an existing edge -> remove the edge */
 	if (is_on_line(e, p)) {
@@ -142,21 +227,27 @@ void insert_point (point_t *p) {
 
 	/* Connect the new point to the vertices of the containing triangle
 	   (or quadrilateral in case the point is on an existing edge */
-	quadedge_t *base = make_edge(e->orig, p);
+	base = make_edge(e->orig, p);
 	add_quadedge(base);
 
 	splice(base, e);
-	starting_edge = base;
+	first = base;
+
+	do {
+		base = connect_quadedge(e, sym(base));
+		add_quadedge(base);
+		e = oprev(base);
+	} while (lnext(e) != first);
 
 	do {
 		quadedge_t *t = oprev(e);
 
-		if (is_at_right_of(e, dest(t)) && incircle(e->orig, dest(t), dest(e), p) ) {
+		if (is_illegal(e, dest(t), p)) {
 			swap_edge(e);
 			e = oprev(e);
 		}
-		else if (onext(e) == starting_edge)
-			return;
+		else if (onext(e) == first)
+			return first;
 		else {
 			quadedge_t *f = onext(e);
 			e = lprev(f);
@@ -164,3 +255,88 @@ void insert_point (point_t *p) {
 	} while (1);
 }
 
+quadedge_t *fix_hull_edge(quadedge_t *h, quadedge_t *base) {
+	quadedge_t *e;
+
+	if (base == NULL || is_infinite(h->orig)) return h;
+
+	/* h has been swapped: the point is on the hull now */
+	e = sym(base);
+	do {
+		if (is_infinite(dest(e))) return sym(e);
+		e = onext(e);
+	} while (e != sym(base));
+
+	return h;
+}
+
+int get_quadedge_hull(point_t **hull) {
+	quadedge_t *e = hull_edge;
+	int h = 0;
+
+	if (e == NULL) return 0;
+
+	do {
+		hull[h++] = dest(e);
+		e = oprev(e);
+	} while (e != hull_edge);
+
+	return h;
+}
+
+/* Keeps p until three non collinear points are known */
+static void add_pending(point_t *p) {
+	point_t *a, *b = NULL;
+	int i;
+
+	if (n_pending == max_pending) {
+		max_pending = max_pending ? 2*max_pending : 16;
+		if ((pending = (point_t **)realloc(pending, max_pending*sizeof(point_t *))) == NULL) {
+			fprintf(stderr, "Unable to allocate pending points\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	pending[n_pending++] = p;
+
+	a = pending[0];
+	for (i=1; i < n_pending-1 && b == NULL; i++)
+		if (pending[i]->x != a->x || pending[i]->y != a->y) b = pending[i];
+	if (b == NULL || (!is_counter_clockwise(a, b, p) && !is_counter_clockwise(a, p, b)))
+		return;
+
+	hull_edge = make_triangulation(a, b, p);
+	starting_edge = hull_edge;
+
+	for (i=1; i < n_pending-1; i++)
+		if (pending[i] != b) insert_point(pending[i]);
+	n_pending = 0;
+}
+
+void insert_point (point_t *p) {
+	quadedge_t *base;
+
+	if (hull_edge == NULL) {
+		add_pending(p);
+		return;
+	}
+
+	base = insert_point_at(locate(p), p);
+	hull_edge = fix_hull_edge(hull_edge, base);
+	if (base != NULL) starting_edge = base;
+}
+
+void checkpoint_delaunay(delaunay_checkpoint_t *c) {
+	c->mark          = checkpoint_quadedges();
+	c->hull_edge     = hull_edge;
+	c->starting_edge = starting_edge;
+	c->n_pending     = n_pending;
+}
+
+/* Edges taken back to the checkpoint are the same objects: the saved
+   edges are valid again */
+void rollback_delaunay(delaunay_checkpoint_t *c) {
+	rollback_quadedges(c->mark);
+	hull_edge     = c->hull_edge;
+	starting_edge = c->starting_edge;
+	n_pending     = c->n_pending;
+}
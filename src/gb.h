@@ -0,0 +1,59 @@
+point_t *new_point(int x, int y);
+void init_delaunay(void);
+
+/* Points have been inserted since init_delaunay() */
+int is_delaunay_started(void);
+
+/* The outside of the hull is made of ghost triangles having this vertex */
+int is_infinite(point_t *p);
+
+/* p is in conflict with the triangle a, b, c (direct order): strictly in its
+   circumcircle, or for a ghost triangle, outside of its hull edge */
+int in_conflict(point_t *a, point_t *b, point_t *c, point_t *p);
+
+/* New triangulation of three points, returns an edge going out of the
+   infinite vertex */
+quadedge_t *make_triangulation(point_t *a, point_t *b, point_t *c);
+
+/* Edge going out of the infinite vertex (NULL until three non collinear
+   points have been inserted), never deleted */
+quadedge_t *get_hull_edge(void);
+void set_hull_edge(quadedge_t *e);
+
+/* Hull edge h after the insertion returning base (h may have been swapped) */
+quadedge_t *fix_hull_edge(quadedge_t *h, quadedge_t *base);
+
+/* Hull vertices in direct order, O(h). hull must hold all the points */
+int get_quadedge_hull(point_t **hull);
+
+quadedge_t *get_starting_edge(void);
+void set_starting_edge(quadedge_t *e);
+
+/* Steps after which a walk stops trusting the geometry to be consistent */
+#define WALK_GUARD 256
+
+/* Steps after which locate_from() scans every edge instead */
+#define WALK_LIMIT (64 * WALK_GUARD)
+
+/* Pseudo-random bit for step number n of a walk (no shared state) */
+#define walk_coin(n) ((int)((((n) * 1103515245u + 12345u) >> 16) & 1))
+
+/* Next edge of the walk from e to p, e itself once p is found */
+quadedge_t *locate_step(quadedge_t *e, point_t *p, unsigned int steps);
+
+quadedge_t *locate_from(quadedge_t *e, point_t *p);
+quadedge_t *locate(point_t *p);
+quadedge_t *insert_point_at(quadedge_t *e, point_t *p);
+void insert_point (point_t *p);
+
+/* State of the triangulation built by insert_point(), to undo the
+   insertions made since (see checkpoint_quadedges()) */
+typedef struct {
+	int mark;
+	quadedge_t *hull_edge;
+	quadedge_t *starting_edge;
+	int n_pending;
+} delaunay_checkpoint_t;
+
+void checkpoint_delaunay(delaunay_checkpoint_t *c);
+void rollback_delaunay(delaunay_checkpoint_t *c);
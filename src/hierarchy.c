@@ -0,0 +1,230 @@
+/*
+    Delaunay hierarchy on top of the quadedge triangulation (gb.c)
+
+    Level 0 is the triangulation built by gb.c. Every point inserted in
+    level i is also inserted in level i+1 with probability 1/RATIO. A point
+    is located by walking the coarsest level, then going down one level at a
+    time, starting each walk from the vertex closest to the point found in
+    the level above. Expected location time is O(log n) whatever the order
+    of insertion.
+
+    All the levels start from the same first triangle and share the
+    infinite vertex of gb.c.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "global.h"
+#include "quadedge.h"
+#include "gb.h"
+#include "hierarchy.h"
+
+#define RATIO 30
+
+/* Vertex present in coarser levels: edges going out of it in each level */
+typedef struct {
+	point_t *p;
+	quadedge_t *e[MAX_LEVELS];
+} hvertex_t;
+
+static quadedge_t *level_hull[MAX_LEVELS];
+static hvertex_t  *vertices = NULL;
+static int         n_vertices = 0;
+static int         max_vertices = 0; /* Power of 2 */
+static unsigned int level_seed = 1;  /* Private: rand() is left to the caller */
+
+static unsigned int hash_point(point_t *p)
+{
+	size_t h = ((size_t)p >> 4) * 2654435761u;
+	return (unsigned int)(h >> 8);
+}
+
+static hvertex_t *find_vertex(point_t *p)
+{
+	unsigned int i;
+
+	if (max_vertices == 0) return NULL;
+
+	i = hash_point(p) & (max_vertices-1);
+	while (vertices[i].p != NULL) {
+		if (vertices[i].p == p) return &vertices[i];
+		i = (i+1) & (max_vertices-1);
+	}
+	return NULL;
+}
+
+static hvertex_t *add_vertex(point_t *p)
+{
+	hvertex_t *old = vertices;
+	int old_max = max_vertices, i;
+	unsigned int j;
+
+	if (2*(n_vertices+1) > max_vertices) {
+		max_vertices = max_vertices ? 2*max_vertices : 256;
+		if ((vertices = (hvertex_t *)calloc(max_vertices, sizeof(hvertex_t))) == NULL) {
+			fprintf(stderr, "Unable to allocate hierarchy vertices\n");
+			exit(EXIT_FAILURE);
+		}
+		n_vertices = 0;
+		for (i=0; i < old_max; i++)
+			if (old[i].p != NULL) *add_vertex(old[i].p) = old[i];
+		free(old);
+	}
+
+	j = hash_point(p) & (max_vertices-1);
+	while (vertices[j].p != NULL) j = (j+1) & (max_vertices-1);
+
+	vertices[j].p = p;
+	n_vertices++;
+	return &vertices[j];
+}
+
+static unsigned int next_random(void)
+{
+	level_seed = level_seed * 1103515245u + 12345u;
+	return level_seed >> 16;
+}
+
+static int random_level(void)
+{
+	int level = 0;
+
+	while (level < MAX_LEVELS-1 && next_random() % RATIO == 0) level++;
+	return level;
+}
+
+static double distance2(point_t *a, point_t *b)
+{
+	return (a->x - b->x)*(a->x - b->x) + (a->y - b->y)*(a->y - b->y);
+}
+
+/* Starting edge in level-1 from the face of e (in level), next to p */
+static quadedge_t *down_edge(quadedge_t *e, point_t *p, int level)
+{
+	quadedge_t *best = level_hull[level-1];
+	double d, d_best = -1;
+	hvertex_t *v;
+	int i;
+
+	for (i=0; i < 3; i++, e = lnext(e)) {
+		if ((v = find_vertex(e->orig)) == NULL) continue; /* Infinite vertex */
+		if (v->e[level-1]->orig != v->p) continue; /* Swapped or deleted */
+
+		d = distance2(e->orig, p);
+		if (d_best < 0 || d < d_best) {
+			d_best = d;
+			best   = v->e[level-1];
+		}
+	}
+
+	return best;
+}
+
+static void locate_all_levels(point_t *p, quadedge_t **located)
+{
+	quadedge_t *e = level_hull[MAX_LEVELS-1];
+	int i;
+
+	for (i=MAX_LEVELS-1; i >= 0; i--) {
+		e = locate_from(e, p);
+		located[i] = e;
+		if (i > 0) e = down_edge(e, p, i);
+	}
+}
+
+/* Edge going out of p in the triangulation of e */
+static quadedge_t *vertex_edge(quadedge_t *e, point_t *p)
+{
+	e = locate_from(e, p);
+	return (dest(e) == p) ? sym(e) : e;
+}
+
+/* The insertion of e->orig in level only swaps or deletes edges of the
+   vertices around it: those of the coarser levels get their spoke of the
+   new star */
+static void refresh_star(quadedge_t *e, int level)
+{
+	quadedge_t *f = e;
+	hvertex_t *v;
+
+	do {
+		if ((v = find_vertex(dest(f))) != NULL) v->e[level] = sym(f);
+		f = onext(f);
+	} while (f != e);
+}
+
+/* The first triangle of level 0 starts every other level */
+static void start_levels(void)
+{
+	quadedge_t *e;
+	point_t *seed[3];
+	hvertex_t *v;
+	int i, k;
+
+	level_hull[0] = get_hull_edge();
+	e = sym(lnext(level_hull[0]));
+	for (k=0; k < 3; k++, e = lnext(e)) seed[k] = e->orig;
+
+	for (i=1; i < MAX_LEVELS; i++)
+		level_hull[i] = make_triangulation(seed[0], seed[1], seed[2]);
+
+	for (k=0; k < 3; k++) {
+		v = add_vertex(seed[k]);
+		for (i=0; i < MAX_LEVELS; i++) v->e[i] = vertex_edge(level_hull[i], seed[k]);
+	}
+}
+
+void init_hierarchy(void)
+{
+	int i;
+
+	init_delaunay();
+	for (i=0; i < MAX_LEVELS; i++) level_hull[i] = NULL;
+
+	free(vertices);
+	vertices = NULL;
+	n_vertices = max_vertices = 0;
+	level_seed = 1;
+}
+
+quadedge_t *hierarchy_locate(point_t *p)
+{
+	quadedge_t *located[MAX_LEVELS];
+
+	if (level_hull[0] == NULL) return NULL;
+	locate_all_levels(p, located);
+	return located[0];
+}
+
+void hierarchy_insert_point(point_t *p)
+{
+	quadedge_t *located[MAX_LEVELS], *base[MAX_LEVELS];
+	hvertex_t *v;
+	int level, i;
+
+	/* gb.c keeps the points until it can make the first triangle */
+	if (level_hull[0] == NULL) {
+		insert_point(p);
+		if (get_hull_edge() != NULL) start_levels();
+		return;
+	}
+
+	level = random_level();
+	locate_all_levels(p, located);
+
+	for (i=0; i <= level; i++) {
+		base[i] = insert_point_at(located[i], p);
+		if (base[i] == NULL) return; /* Duplicate */
+		level_hull[i] = fix_hull_edge(level_hull[i], base[i]);
+		refresh_star(sym(base[i]), i);
+	}
+	set_starting_edge(base[0]);
+	set_hull_edge(level_hull[0]);
+
+	/* No edge kept by the levels is deleted anymore (all levels share
+	   the list of gb.c) */
+	collect_deleted_edges();
+
+	if (level == 0) return;
+	v = add_vertex(p);
+	for (i=0; i <= level; i++) v->e[i] = sym(base[i]);
+}
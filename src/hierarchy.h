@@ -0,0 +1,10 @@
+#define MAX_LEVELS 5
+
+/* Starts a new triangulation (calls init_delaunay()) with coarser levels */
+void init_hierarchy(void);
+
+/* Same result as locate(), in expected O(log n) */
+quadedge_t *hierarchy_locate(point_t *p);
+
+/* Replaces insert_point() for triangulations started by init_hierarchy() */
+void hierarchy_insert_point(point_t *p);
@@ -0,0 +1,335 @@
+/*
+    Kinetic update of the quadedge triangulation (gb.c)
+
+    Moved vertices keep their edges as long as none of their triangles is
+    inverted by the move (and the hull stays convex around hull vertices).
+    The Delaunay property is then restored by flipping
+    the edges around them (Lawson flips). A vertex whose triangles would
+    invert is removed (its degree is brought down to 3 by flips, then its
+    last three edges are deleted) and inserted again at its new position.
+    The cost of an update only depends on the moved vertices and on the
+    number of flips.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include "global.h"
+#include "quadedge.h"
+#include "gb.h"
+#include "kinetic.h"
+
+static void *kinetic_alloc(size_t size)
+{
+	void *p;
+
+	if ((p = malloc(size)) == NULL) {
+		fprintf(stderr, "Unable to allocate kinetic triangulation\n");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+static int vertex_index(kinetic_t *k, point_t *p)
+{
+	if (p < k->cloud || p >= k->cloud + k->n) return -1; /* Infinite vertex */
+	return (int)(p - k->cloud);
+}
+
+kinetic_t *init_kinetic(point_t *cloud, int n)
+{
+	kinetic_t *k = (kinetic_t *)kinetic_alloc(sizeof(kinetic_t));
+	quadedge_t **edges;
+	int n_edges, i, v;
+
+	k->cloud = cloud;
+	k->n     = n;
+	k->edge  = (quadedge_t **)kinetic_alloc(n * sizeof(quadedge_t *));
+	for (i=0; i < n; i++) k->edge[i] = NULL;
+
+	edges = collect_edges(get_hull_edge(), &n_edges);
+	for (i=0; i < n_edges; i++)
+		if ((v = vertex_index(k, edges[i]->orig)) >= 0) k->edge[v] = edges[i];
+	free(edges);
+
+	k->max_queue = 1024;
+	k->n_queue   = 0;
+	k->queue     = (quadedge_t **)kinetic_alloc(k->max_queue * sizeof(quadedge_t *));
+
+	k->max_failed = (n > 0) ? n : 1;
+	k->n_failed   = 0;
+	k->failed     = (int *)kinetic_alloc(k->max_failed * sizeof(int));
+
+	return k;
+}
+
+void destroy_kinetic(kinetic_t *k)
+{
+	if (k == NULL) return;
+
+	free(k->edge);
+	free(k->queue);
+	free(k->failed);
+	free(k);
+}
+
+/* Edge going out of vertex i, NULL if it is not in the triangulation */
+static quadedge_t *vertex_edge(kinetic_t *k, int i)
+{
+	quadedge_t *e = k->edge[i];
+	point_t *v = k->cloud + i;
+
+	if (e == NULL) return NULL;
+	if (is_deleted(e)) e = get_hull_edge();
+
+	if (e->orig != v) {
+		e = locate_from(e, v); /* Stops on the edge having v as extremity */
+		if (dest(e) == v) e = sym(e);
+		if (e->orig != v) e = NULL;
+	}
+
+	k->edge[i] = e;
+	return e;
+}
+
+/* e is going to be swapped or deleted: its extremities need another edge */
+static void forget_edge(kinetic_t *k, quadedge_t *e)
+{
+	quadedge_t *h = get_hull_edge();
+	int i;
+
+	if (h == e || h == sym(e)) set_hull_edge(onext(h));
+	if ((i = vertex_index(k, e->orig)) >= 0 && k->edge[i] == e)
+		k->edge[i] = onext(e);
+	if ((i = vertex_index(k, dest(e))) >= 0 && k->edge[i] == sym(e))
+		k->edge[i] = onext(sym(e));
+}
+
+static void push_edge(kinetic_t *k, quadedge_t *e)
+{
+	if (k->n_queue == k->max_queue) {
+		k->max_queue *= 2;
+		if ((k->queue = (quadedge_t **)realloc(k->queue, k->max_queue * sizeof(quadedge_t *))) == NULL) {
+			fprintf(stderr, "Unable to allocate flip queue\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	k->queue[k->n_queue++] = e;
+}
+
+static point_t *apex(quadedge_t *e)
+{
+	return dest(lnext(e));
+}
+
+static int is_triangle(quadedge_t *e)
+{
+	return (lnext(lnext(lnext(e))) == e);
+}
+
+static void push_star(kinetic_t *k, quadedge_t *e)
+{
+	quadedge_t *f = e;
+
+	do {
+		push_edge(k, f);
+		push_edge(k, lnext(f));
+		f = onext(f);
+	} while (f != e);
+}
+
+/* Lawson flips of the queued edges and of the edges around each flip */
+static void restore_delaunay(kinetic_t *k)
+{
+	quadedge_t *e;
+	point_t *a, *b, *c, *d;
+
+	while (k->n_queue > 0) {
+		e = k->queue[--k->n_queue];
+		if (is_deleted(e) || !is_triangle(e) || !is_triangle(sym(e))) continue;
+
+		a = e->orig; b = dest(e); c = apex(e); d = apex(sym(e));
+		if (is_infinite(d) || !in_conflict(a, b, c, d)) continue;
+		if (!is_infinite(a) && !is_infinite(b) && !is_infinite(c) &&
+		    (!is_counter_clockwise(d, b, c) || !is_counter_clockwise(c, a, d))) continue;
+
+		forget_edge(k, e);
+		swap_edge(e);
+		push_edge(k, lnext(e));
+		push_edge(k, lprev(e));
+		push_edge(k, lnext(sym(e)));
+		push_edge(k, lprev(sym(e)));
+	}
+}
+
+/* Hull vertices around f (going to the infinite vertex) are y, f->orig, x
+   with the outside on the left. None of them may become reflex */
+static int is_convex_hull_move(quadedge_t *f, point_t *q)
+{
+	quadedge_t *g = lprev(f), *h = lnext(sym(f));
+	point_t *y = g->orig, *x = dest(h);
+	point_t *y0 = lprev(sym(lprev(g)))->orig, *x1 = dest(lnext(sym(lnext(h))));
+
+	return !is_counter_clockwise(y, q, x) && !is_counter_clockwise(y0, y, q) &&
+	       !is_counter_clockwise(q, x, x1);
+}
+
+/* None of the triangles around e inverts if e->orig is moved to q */
+static int is_valid_move(quadedge_t *e, point_t *q)
+{
+	quadedge_t *f = e;
+
+	do {
+		if (is_infinite(dest(f))) {
+			if (!is_convex_hull_move(f, q)) return 0;
+		}
+		else if (!is_infinite(apex(f)) && !is_counter_clockwise(q, dest(f), apex(f)))
+			return 0;
+		f = onext(f);
+	} while (f != e);
+
+	return 1;
+}
+
+static int degree(quadedge_t *e)
+{
+	quadedge_t *f = e;
+	int d = 0;
+
+	do {
+		d++;
+		f = onext(f);
+	} while (f != e);
+
+	return d;
+}
+
+static int is_hull_vertex(quadedge_t *e)
+{
+	quadedge_t *f = e;
+
+	do {
+		if (is_infinite(dest(f))) return 1;
+		f = onext(f);
+	} while (f != e);
+
+	return 0;
+}
+
+/* Spoke f = v-a can be flipped: the quadrilateral v, p, a, n is convex,
+   (pass 1) convex but for v on p-n, or (pass 2) the triangle between f and
+   the hull can leave the triangulation. After a pass 1 flip, v is on the
+   new edge and p, n, v is flat: v has no other straight angle, and the
+   flat triangle goes with the last three spokes */
+static int is_flippable_spoke(quadedge_t *f, int pass)
+{
+	point_t *v = f->orig, *p = apex(sym(f)), *a = dest(f), *n = apex(f);
+
+	if (is_infinite(a)) return 0;
+	if (pass < 2)
+		return !is_infinite(p) && !is_infinite(n) && is_counter_clockwise(p, a, n) &&
+		       (pass == 0 ? is_counter_clockwise(n, v, p) : !is_counter_clockwise(v, n, p));
+	if (is_infinite(n)) return !is_hull_vertex(sym(lnext(sym(f))));
+	if (is_infinite(p)) return !is_hull_vertex(lprev(f));
+	return 0;
+}
+
+/* Takes e->orig out of the triangulation. Returns an edge of the hole, or
+   NULL if rounding errors left no spoke to flip (the vertex stays) */
+static quadedge_t *remove_vertex(kinetic_t *k, quadedge_t *e)
+{
+	quadedge_t *f, *g;
+	int i, pass, found;
+
+	push_star(k, e);
+
+	/* Flip spokes until the degree is 3, inside the hull first */
+	while (degree(e) > 3) {
+		found = 0;
+		for (pass=0; pass < 3 && !found; pass++) {
+			f = e;
+			do {
+				if ((found = is_flippable_spoke(f, pass))) break;
+				f = onext(f);
+			} while (f != e);
+		}
+		if (!found) return NULL;
+
+		if (f == e) e = onext(e);
+		forget_edge(k, f);
+		swap_edge(f);
+		push_edge(k, f);
+	}
+
+	/* Then delete the last three */
+	g = lnext(e);
+	for (i=0; i < 3; i++) {
+		f = onext(e);
+		forget_edge(k, e);
+		delete_edge(e);
+		e = f;
+	}
+
+	push_edge(k, g);
+	push_edge(k, lnext(g));
+	push_edge(k, lprev(g));
+	return g;
+}
+
+/* The insertion of e->orig deletes or swaps edges of the vertices around
+   it only: they all get their spoke of the new star */
+static void refresh_star(kinetic_t *k, quadedge_t *e)
+{
+	quadedge_t *f = e;
+	int i;
+
+	k->edge[vertex_index(k, e->orig)] = e;
+	do {
+		if ((i = vertex_index(k, dest(f))) >= 0) k->edge[i] = sym(f);
+		f = onext(f);
+	} while (f != e);
+}
+
+int move_vertices(kinetic_t *k, int *index, point_t *pos, int m)
+{
+	quadedge_t *e, *base;
+	point_t *v;
+	int i, reinserted = 0;
+
+	k->n_failed = 0;
+	if (m > k->max_failed) { /* index may repeat a vertex */
+		k->max_failed = m;
+		free(k->failed);
+		k->failed = (int *)kinetic_alloc(m * sizeof(int));
+	}
+	for (i=0; i < m; i++) {
+		v = k->cloud + index[i];
+		e = vertex_edge(k, index[i]);
+
+		if (e != NULL && is_valid_move(e, pos + i)) {
+			*v = pos[i];
+			push_star(k, e);
+			restore_delaunay(k);
+			continue;
+		}
+
+		if (e == NULL) /* Was a duplicate point: not in the triangulation */
+			e = get_hull_edge();
+		else if ((e = remove_vertex(k, e)) == NULL) {
+			restore_delaunay(k);
+			k->failed[k->n_failed++] = index[i];
+			continue;
+		}
+		restore_delaunay(k);
+
+		*v = pos[i];
+		base = insert_point_at(locate_from(e, v), v);
+		set_hull_edge(fix_hull_edge(get_hull_edge(), base));
+		if (base == NULL) k->edge[index[i]] = NULL;
+		else refresh_star(k, sym(base));
+		reinserted++;
+	}
+
+	/* No edge of k->edge, of the hull or of locate() is deleted anymore */
+	set_starting_edge(get_hull_edge());
+	collect_deleted_edges();
+	return reinserted;
+}
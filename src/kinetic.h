@@ -0,0 +1,22 @@
+typedef struct {
+	point_t *cloud;
+	int n;
+	quadedge_t **edge;   /* Edge going out of each vertex (checked before use) */
+	quadedge_t **queue;  /* Edges to check for the Delaunay property */
+	int n_queue;
+	int max_queue;
+	int *failed;         /* Vertices the last move_vertices() left in place */
+	int n_failed;
+	int max_failed;
+} kinetic_t;
+
+/* Kinetic handle on the triangulation built by gb.c from the n points of cloud */
+kinetic_t *init_kinetic(point_t *cloud, int n);
+void destroy_kinetic(kinetic_t *k);
+
+/* Moves cloud[index[i]] to pos[i] for the m given vertices and restores
+   the Delaunay property. Returns the number of vertices that had to be
+   removed and inserted again. A vertex whose removal is prevented by
+   degenerate neighbors stays in place (its cloud entry too): k->failed
+   lists the n_failed of them. The deleted edges are freed on return */
+int move_vertices(kinetic_t *k, int *index, point_t *pos, int m);
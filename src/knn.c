@@ -0,0 +1,187 @@
+/*
+    All points k nearest neighbors from a triangulation
+
+    The j-th nearest neighbor of a vertex is linked by a Delaunay edge to
+    the vertex itself or to one of its j-1 nearest neighbors. The search
+    from a vertex pops the closest vertex reached so far from a priority
+    queue and pushes its own neighbors, until k vertices are popped: only
+    about k times the mean degree vertices are looked at.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <pthread.h>
+#include "global.h"
+#include "delaunay.h"
+#include "quadedge.h"
+#include "ctable.h"
+#include "knn.h"
+
+#define CHUNK 256 /* Vertices taken at once by a worker */
+
+typedef struct {
+	double d;
+	uint32_t v;
+} candidate_t;
+
+typedef struct {
+	corner_table_t *ct;
+	ct_adjacency_t a;
+	int k;
+	uint32_t *index;
+	double *distance;
+	volatile int next;
+} knn_batch_t;
+
+typedef struct {
+	knn_batch_t *b;
+	uint32_t *mark;     /* 1 + last vertex whose search reached each vertex */
+	candidate_t *heap;
+	int n_heap;
+	int max_heap;
+} knn_worker_t;
+
+static void *knn_alloc(size_t size)
+{
+	void *p;
+
+	if ((p = malloc(size)) == NULL) {
+		fprintf(stderr, "Unable to allocate nearest neighbor graph\n");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+static void push_candidate(knn_worker_t *w, double d, uint32_t v)
+{
+	candidate_t *h;
+	int i, parent;
+
+	if (w->n_heap == w->max_heap) {
+		w->max_heap = w->max_heap ? 2*w->max_heap : 64;
+		if ((w->heap = (candidate_t *)realloc(w->heap, w->max_heap*sizeof(candidate_t))) == NULL) {
+			fprintf(stderr, "Unable to allocate nearest neighbor queue\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	h = w->heap;
+	for (i = w->n_heap++; i > 0 && h[parent = (i-1)/2].d > d; i = parent)
+		h[i] = h[parent];
+	h[i].d = d;
+	h[i].v = v;
+}
+
+static candidate_t pop_candidate(knn_worker_t *w)
+{
+	candidate_t *h = w->heap, top = h[0], last = h[--w->n_heap];
+	int i = 0, child;
+
+	while ((child = 2*i+1) < w->n_heap) {
+		if (child+1 < w->n_heap && h[child+1].d < h[child].d) child++;
+		if (h[child].d >= last.d) break;
+		h[i] = h[child];
+		i = child;
+	}
+	h[i] = last;
+
+	return top;
+}
+
+static void push_neighbors(knn_worker_t *w, uint32_t i, uint32_t v)
+{
+	ct_adjacency_t *a = &w->b->a;
+	point_t *cloud = w->b->ct->cloud, *p = cloud + i, *q;
+	uint32_t j, u;
+
+	for (j = a->first[v]; j < a->first[v+1]; j++) {
+		if (w->mark[u = a->adj[j]] == i+1) continue;
+		w->mark[u] = i+1;
+		q = cloud + u;
+		push_candidate(w, (q->x - p->x)*(q->x - p->x) + (q->y - p->y)*(q->y - p->y), u);
+	}
+}
+
+static void search(knn_worker_t *w, uint32_t i)
+{
+	knn_batch_t *b = w->b;
+	uint32_t *index = b->index + (size_t)i*b->k;
+	double *distance = b->distance + (size_t)i*b->k;
+	candidate_t c;
+	int found = 0;
+
+	w->n_heap = 0;
+	w->mark[i] = i+1;
+	push_neighbors(w, i, i);
+
+	while (found < b->k && w->n_heap > 0) {
+		c = pop_candidate(w);
+		index[found]      = c.v;
+		distance[found++] = sqrt(c.d);
+		push_neighbors(w, i, c.v);
+	}
+
+	for (; found < b->k; found++) {
+		index[found]    = KNN_NONE;
+		distance[found] = -1;
+	}
+}
+
+static void *knn_worker(void *arg)
+{
+	knn_worker_t *w = (knn_worker_t *)arg;
+	int n = (int)w->b->ct->n_vertices, i, first;
+
+	while ((first = __sync_fetch_and_add(&w->b->next, CHUNK)) < n) {
+		for (i=first; i < first + CHUNK && i < n; i++)
+			search(w, (uint32_t)i);
+	}
+
+	return NULL;
+}
+
+void knn_graph(corner_table_t *ct, int k, int n_threads, uint32_t *index, double *distance)
+{
+	knn_worker_t *workers;
+	pthread_t *threads;
+	knn_batch_t batch;
+	uint32_t i;
+	int t;
+
+	if (k <= 0 || ct->n_vertices == 0) return;
+	if (n_threads < 1) n_threads = 1;
+
+	batch.ct       = ct;
+	batch.k        = k;
+	batch.index    = index;
+	batch.distance = distance;
+	batch.next     = 0;
+	ct_build_adjacency(ct, &batch.a);
+
+	workers = (knn_worker_t *)knn_alloc(n_threads * sizeof(knn_worker_t));
+	threads = (pthread_t *)knn_alloc(n_threads * sizeof(pthread_t));
+
+	for (t=0; t < n_threads; t++) {
+		workers[t].b        = &batch;
+		workers[t].mark     = (uint32_t *)knn_alloc(ct->n_vertices * sizeof(uint32_t));
+		workers[t].heap     = NULL;
+		workers[t].n_heap   = 0;
+		workers[t].max_heap = 0;
+		for (i=0; i < ct->n_vertices; i++) workers[t].mark[i] = 0;
+
+		if (pthread_create(&threads[t], NULL, knn_worker, &workers[t]) != 0) {
+			fprintf(stderr, "Unable to start nearest neighbor worker %d\n", t);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (t=0; t < n_threads; t++) {
+		pthread_join(threads[t], NULL);
+		free(workers[t].mark);
+		free(workers[t].heap);
+	}
+
+	ct_free_adjacency(&batch.a);
+	free(threads);
+	free(workers);
+}
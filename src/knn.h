@@ -0,0 +1,7 @@
+#define KNN_NONE 0xffffffffu
+
+/* k nearest neighbors of every vertex of ct, found by walking out along the
+   Delaunay edges. index[i*k+j] is the j-th nearest neighbor of vertex i and
+   distance[i*k+j] its distance (KNN_NONE and -1 past the last neighbor).
+   The vertices are shared by n_threads workers */
+void knn_graph(corner_table_t *ct, int k, int n_threads, uint32_t *index, double *distance);
@@ -0,0 +1,541 @@
+/*
+    Lloyd relaxation over a corner table
+
+    The points are triangulated together with the corners of a square frame
+    far around the domain (further from any point of the domain than the
+    domain is wide, so that the frame takes nothing from the cells inside
+    the domain): every point is inside the hull, which never changes.
+
+    Each iteration computes the circumcenter of every triangle once, then
+    the Voronoi cell of every point in parallel: the polygon of the
+    circumcenters of the triangles around it, clipped to the domain
+    (Sutherland-Hodgman). The points move to the centroids of their cells.
+
+    The triangulation is then repaired rather than built again. A move
+    inverting a triangle (a parallel pass finds them) is halved, up to
+    MAX_HALVINGS times, then put off until the next iteration: the moves
+    still lower the energy, and the triangulation stays valid. Lawson flips
+    of the edges found by a parallel incircle pass restore the Delaunay
+    property.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "global.h"
+#include "delaunay.h"
+#include "quadedge.h"
+#include "ctable.h"
+#include "sweephull.h"
+#include "lloyd.h"
+
+#define CHUNK 1024 /* Triangles taken at once by a worker */
+#define MAX_HALVINGS 4
+#define FRAME_SIZE 8 /* Width of the frame, in widths of the domain */
+
+typedef struct {
+	lloyd_t *l;
+	point_t *poly;          /* Cell being clipped, relative to its point */
+	point_t *tmp;
+	uint32_t max_poly;
+	double max_move;        /* Squared */
+	uint32_t *found;        /* Inverted triangles, or corners facing edges to flip */
+	uint32_t n_found;
+	uint32_t max_found;
+} lloyd_worker_t;
+
+struct lloyd_s {
+	point_t *cloud;
+	uint32_t n;
+	point_t *points;        /* cloud, then the 4 corners of the frame */
+	corner_table_t *ct;     /* Indexes points */
+	point_t *domain;
+	int n_domain;
+	point_t *center;        /* Circumcenter of each triangle */
+	uint32_t *corner;       /* Corner of each point */
+	point_t *centroid;
+	point_t *previous;      /* Points before the moves */
+	unsigned char *halvings;
+	uint32_t *stack;        /* Triangles, then edges to check */
+	uint32_t n_stack;
+	uint32_t max_stack;
+	int n_threads;
+	lloyd_worker_t *workers;
+	volatile int next;
+};
+
+static void *lloyd_alloc(size_t size)
+{
+	void *p;
+
+	if ((p = malloc(size ? size : 1)) == NULL) {
+		fprintf(stderr, "Unable to allocate Lloyd relaxation\n");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+static void push(uint32_t **stack, uint32_t *n, uint32_t *max, uint32_t x)
+{
+	if (*n == *max) {
+		*max = *max ? 2 * *max : 1024;
+		if ((*stack = (uint32_t *)realloc(*stack, *max * sizeof(uint32_t))) == NULL) {
+			fprintf(stderr, "Unable to allocate Lloyd relaxation\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	(*stack)[(*n)++] = x;
+}
+
+static void run_phase(lloyd_t *l, void *(*phase)(void *))
+{
+	pthread_t *threads = (pthread_t *)lloyd_alloc(l->n_threads * sizeof(pthread_t));
+	int t;
+
+	l->next = 0;
+	for (t=0; t < l->n_threads; t++) {
+		if (pthread_create(&threads[t], NULL, phase, &l->workers[t]) != 0) {
+			fprintf(stderr, "Unable to start Lloyd worker %d\n", t);
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (t=0; t < l->n_threads; t++) pthread_join(threads[t], NULL);
+
+	free(threads);
+}
+
+/* Runs a phase filling the lists of the workers, then stacks them */
+static void find(lloyd_t *l, void *(*phase)(void *))
+{
+	uint32_t i;
+	int t;
+
+	for (t=0; t < l->n_threads; t++) l->workers[t].n_found = 0;
+	run_phase(l, phase);
+
+	l->n_stack = 0;
+	for (t=0; t < l->n_threads; t++)
+		for (i=0; i < l->workers[t].n_found; i++)
+			push(&l->stack, &l->n_stack, &l->max_stack, l->workers[t].found[i]);
+}
+
+/* > 0 if a, b, c are in direct order */
+static double orient(point_t *a, point_t *b, point_t *c)
+{
+	return (b->x - a->x) * (c->y - a->y) - (b->y - a->y) * (c->x - a->x);
+}
+
+/* > 0 if d is inside the circle through a, b, c (in direct order) */
+static double in_circle(point_t *a, point_t *b, point_t *c, point_t *d)
+{
+	double ax = a->x - d->x, ay = a->y - d->y;
+	double bx = b->x - d->x, by = b->y - d->y;
+	double cx = c->x - d->x, cy = c->y - d->y;
+
+	return (ax*ax + ay*ay) * (bx*cy - cx*by) - (bx*bx + by*by) * (ax*cy - cx*ay) +
+	       (cx*cx + cy*cy) * (ax*by - bx*ay);
+}
+
+static void find_corners(lloyd_t *l)
+{
+	corner_table_t *ct = l->ct;
+	uint32_t c, i;
+
+	for (i=0; i < l->n; i++) l->corner[i] = NO_CORNER;
+	for (c=0; c < 3*ct->n_triangles; c++)
+		if (ct->v[c] < l->n) l->corner[ct->v[c]] = c;
+}
+
+static void *center_phase(void *arg)
+{
+	lloyd_t *l = ((lloyd_worker_t *)arg)->l;
+	corner_table_t *ct = l->ct;
+	int n = (int)ct->n_triangles, first;
+	double bx, by, cx, cy, b2, c2, d;
+	point_t *a, *b, *c;
+	uint32_t t;
+
+	while ((first = __sync_fetch_and_add(&l->next, CHUNK)) < n) {
+		for (t=first; t < (uint32_t)(first + CHUNK) && t < (uint32_t)n; t++) {
+			a = ct->cloud + ct->v[3*t];
+			b = ct->cloud + ct->v[3*t+1];
+			c = ct->cloud + ct->v[3*t+2];
+			bx = b->x - a->x; by = b->y - a->y;
+			cx = c->x - a->x; cy = c->y - a->y;
+			b2 = bx*bx + by*by;
+			c2 = cx*cx + cy*cy;
+			d  = 2 * (bx*cy - by*cx);
+			l->center[t].x = a->x + (cy*b2 - by*c2) / d;
+			l->center[t].y = a->y + (bx*c2 - cx*b2) / d;
+		}
+	}
+	return NULL;
+}
+
+/* Part of the polygon where nx x + ny y <= k, into out. Returns its size */
+static uint32_t clip(point_t *poly, uint32_t n, point_t *out, double nx, double ny, double k)
+{
+	point_t *a, *b;
+	double f0, f1, s;
+	uint32_t i, m = 0;
+
+	if (n == 0) return 0;
+
+	a  = poly + n-1;
+	f0 = nx * a->x + ny * a->y - k;
+	for (i=0; i < n; i++, a = b, f0 = f1) {
+		b  = poly + i;
+		f1 = nx * b->x + ny * b->y - k;
+		if ((f0 <= 0) != (f1 <= 0)) {
+			s = f0 / (f0 - f1);
+			out[m].x = a->x + s * (b->x - a->x);
+			out[m].y = a->y + s * (b->y - a->y);
+			m++;
+		}
+		if (f1 <= 0) out[m++] = *b;
+	}
+	return m;
+}
+
+/* Centroid of the cell of point q */
+static void cell(lloyd_worker_t *w, uint32_t q)
+{
+	lloyd_t *l = w->l;
+	corner_table_t *ct = l->ct;
+	point_t *p = l->points + q, *u, *d0, *d1, *tmp;
+	uint32_t c0 = l->corner[q], c, deg, n, i;
+	double area, x, y, cr;
+	int k;
+
+	l->centroid[q] = *p;
+
+	for (deg=1, c = CT_NEXT(ct->o[CT_NEXT(c0)]); c != c0; deg++)
+		c = CT_NEXT(ct->o[CT_NEXT(c)]);
+
+	/* Each clip adds a vertex at most (twice that with rounding errors) */
+	if (w->max_poly < 2 * (deg + l->n_domain)) {
+		w->max_poly = 2 * (deg + l->n_domain);
+		free(w->poly);
+		free(w->tmp);
+		w->poly = (point_t *)lloyd_alloc(w->max_poly * sizeof(point_t));
+		w->tmp  = (point_t *)lloyd_alloc(w->max_poly * sizeof(point_t));
+	}
+
+	/* Circumcenters of the triangles around q, counterclockwise */
+	for (n=0, c=c0; n < deg; n++) {
+		w->poly[n].x = l->center[c/3].x - p->x;
+		w->poly[n].y = l->center[c/3].y - p->y;
+		c = CT_NEXT(ct->o[CT_NEXT(c)]);
+	}
+
+	for (k=0; k < l->n_domain; k++) {
+		d0 = l->domain + k;
+		d1 = l->domain + (k+1) % l->n_domain;
+		x = d1->x - d0->x;
+		y = d1->y - d0->y;
+		n = clip(w->poly, n, w->tmp, y, -x, y * (d0->x - p->x) - x * (d0->y - p->y));
+		tmp = w->poly; w->poly = w->tmp; w->tmp = tmp;
+	}
+
+	for (i=0, area=0, x=0, y=0; i < n; i++) {
+		u  = w->poly + (i+1) % n;
+		cr = w->poly[i].x * u->y - u->x * w->poly[i].y;
+		area += cr;
+		x += (w->poly[i].x + u->x) * cr;
+		y += (w->poly[i].y + u->y) * cr;
+	}
+	if (area <= 0) return; /* Empty cell: p is outside of the domain */
+
+	x /= 3 * area;
+	y /= 3 * area;
+	l->centroid[q].x = p->x + x;
+	l->centroid[q].y = p->y + y;
+	if (x*x + y*y > w->max_move) w->max_move = x*x + y*y;
+}
+
+/* Points in the order of the triangles, which keeps the triangles around
+   them in nearby memory. Each is taken at the corner find_corners() kept */
+static void *cell_phase(void *arg)
+{
+	lloyd_worker_t *w = (lloyd_worker_t *)arg;
+	lloyd_t *l = w->l;
+	uint32_t *v = l->ct->v, c, q;
+	int n = (int)l->ct->n_triangles, first;
+
+	while ((first = __sync_fetch_and_add(&l->next, CHUNK)) < n) {
+		for (c = 3*first; c < 3*(uint32_t)(first + CHUNK) && c < 3*(uint32_t)n; c++) {
+			q = v[c];
+			if (q < l->n && l->corner[q] == c) cell(w, q);
+		}
+	}
+	return NULL;
+}
+
+static int is_inverted(corner_table_t *ct, uint32_t t)
+{
+	return (orient(ct->cloud + ct->v[3*t], ct->cloud + ct->v[3*t+1], ct->cloud + ct->v[3*t+2]) <= 0);
+}
+
+static void *orient_phase(void *arg)
+{
+	lloyd_worker_t *w = (lloyd_worker_t *)arg;
+	corner_table_t *ct = w->l->ct;
+	int n = (int)ct->n_triangles, first;
+	uint32_t t;
+
+	while ((first = __sync_fetch_and_add(&w->l->next, CHUNK)) < n)
+		for (t=first; t < (uint32_t)(first + CHUNK) && t < (uint32_t)n; t++)
+			if (is_inverted(ct, t)) push(&w->found, &w->n_found, &w->max_found, t);
+	return NULL;
+}
+
+/* Shortens the moves inverting triangles, until none is */
+static void hold_back(lloyd_t *l)
+{
+	corner_table_t *ct = l->ct;
+	uint32_t t, q, c;
+	point_t *p, *p0;
+	int k;
+
+	find(l, orient_phase);
+	while (l->n_stack > 0) {
+		t = l->stack[--l->n_stack];
+		if (!is_inverted(ct, t)) continue;
+
+		for (k=0; k < 3; k++) {
+			q = ct->v[3*t+k];
+			if (q >= l->n) continue; /* Frame */
+			p  = l->points + q;
+			p0 = l->previous + q;
+			if (p->x == p0->x && p->y == p0->y) continue;
+
+			if (l->halvings[q]++ < MAX_HALVINGS) {
+				p->x = (p->x + p0->x) / 2;
+				p->y = (p->y + p0->y) / 2;
+			}
+			else
+				*p = *p0;
+
+			c = l->corner[q]; /* Triangles around q */
+			do {
+				push(&l->stack, &l->n_stack, &l->max_stack, c/3);
+				c = CT_NEXT(ct->o[CT_NEXT(c)]);
+			} while (c != l->corner[q]);
+		}
+	}
+}
+
+/* The edge facing c is not locally Delaunay */
+static int is_flippable(corner_table_t *ct, uint32_t c)
+{
+	uint32_t e = ct->o[c];
+
+	return (e != NO_CORNER &&
+	        in_circle(ct->cloud + ct->v[c], ct->cloud + ct->v[CT_NEXT(c)], ct->cloud + ct->v[CT_PREV(c)],
+	                  ct->cloud + ct->v[e]) > 0);
+}
+
+static void *conflict_phase(void *arg)
+{
+	lloyd_worker_t *w = (lloyd_worker_t *)arg;
+	corner_table_t *ct = w->l->ct;
+	int n = (int)ct->n_triangles, first;
+	uint32_t c;
+
+	while ((first = __sync_fetch_and_add(&w->l->next, CHUNK)) < n)
+		for (c = 3*first; c < 3*(uint32_t)(first + CHUNK) && c < 3*(uint32_t)n; c++)
+			if (ct->o[c] != NO_CORNER && ct->o[c] > c && is_flippable(ct, c))
+				push(&w->found, &w->n_found, &w->max_found, c);
+	return NULL;
+}
+
+/* Triangles a, b, d (corner c at a) and x, d, b become a, b, x and x, d, a */
+static void flip(corner_table_t *ct, uint32_t c)
+{
+	uint32_t e = ct->o[c], c1 = CT_NEXT(c), e1 = CT_NEXT(e);
+	uint32_t a1 = ct->o[c1], b1 = ct->o[e1];
+
+	ct->v[CT_PREV(c)] = ct->v[e];
+	ct->v[CT_PREV(e)] = ct->v[c];
+	ct->o[c]  = b1;
+	ct->o[e]  = a1;
+	ct->o[c1] = e1;
+	ct->o[e1] = c1;
+	if (b1 != NO_CORNER) ct->o[b1] = c;
+	if (a1 != NO_CORNER) ct->o[a1] = e;
+}
+
+static void flip_edges(lloyd_t *l)
+{
+	corner_table_t *ct = l->ct;
+	uint32_t c, e;
+	point_t *a, *b, *d, *x;
+
+	find(l, conflict_phase);
+	while (l->n_stack > 0) {
+		c = l->stack[--l->n_stack];
+		if (!is_flippable(ct, c)) continue;
+
+		e = ct->o[c];
+		a = ct->cloud + ct->v[c];
+		b = ct->cloud + ct->v[CT_NEXT(c)];
+		d = ct->cloud + ct->v[CT_PREV(c)];
+		x = ct->cloud + ct->v[e];
+		if (orient(a, b, x) <= 0 || orient(x, d, a) <= 0) continue; /* Rounding errors */
+
+		flip(ct, c);
+		push(&l->stack, &l->n_stack, &l->max_stack, c);
+		push(&l->stack, &l->n_stack, &l->max_stack, CT_PREV(c));
+		push(&l->stack, &l->n_stack, &l->max_stack, e);
+		push(&l->stack, &l->n_stack, &l->max_stack, CT_PREV(e));
+	}
+}
+
+/* Square around the points and the domain, FRAME_SIZE times wider */
+static void set_frame(lloyd_t *l)
+{
+	double x0, y0, x1, y1, h;
+	point_t *p;
+	uint32_t i;
+
+	x0 = x1 = l->domain[0].x;
+	y0 = y1 = l->domain[0].y;
+	for (i=0; i < l->n + (uint32_t)l->n_domain; i++) {
+		p = (i < l->n) ? l->points + i : l->domain + (i - l->n);
+		if (p->x < x0) x0 = p->x;
+		if (p->x > x1) x1 = p->x;
+		if (p->y < y0) y0 = p->y;
+		if (p->y > y1) y1 = p->y;
+	}
+	h = FRAME_SIZE * ((x1 - x0 > y1 - y0) ? x1 - x0 : y1 - y0) / 2;
+	if (h == 0) h = 1;
+
+	p = l->points + l->n;
+	p[0].x = (x0 + x1) / 2 - h; p[0].y = (y0 + y1) / 2 - h;
+	p[1].x = (x0 + x1) / 2 + h; p[1].y = (y0 + y1) / 2 - h;
+	p[2].x = (x0 + x1) / 2 + h; p[2].y = (y0 + y1) / 2 + h;
+	p[3].x = (x0 + x1) / 2 - h; p[3].y = (y0 + y1) / 2 + h;
+}
+
+lloyd_t *init_lloyd(point_t *cloud, int n, point_t *domain, int n_domain, int n_threads)
+{
+	lloyd_t *l;
+	int i;
+
+	if (n < 1 || (domain != NULL && n_domain < 3)) return NULL;
+
+	l = (lloyd_t *)lloyd_alloc(sizeof(lloyd_t));
+	l->cloud  = cloud;
+	l->n      = (uint32_t)n;
+	l->points = (point_t *)lloyd_alloc((n + 4) * sizeof(point_t));
+	memcpy(l->points, cloud, n * sizeof(point_t));
+
+	if (domain == NULL) { /* Bounding box */
+		l->n_domain = 4;
+		l->domain   = (point_t *)lloyd_alloc(4 * sizeof(point_t));
+		l->domain[0] = l->domain[2] = cloud[0];
+		for (i=1; i < n; i++) {
+			if (cloud[i].x < l->domain[0].x) l->domain[0].x = cloud[i].x;
+			if (cloud[i].y < l->domain[0].y) l->domain[0].y = cloud[i].y;
+			if (cloud[i].x > l->domain[2].x) l->domain[2].x = cloud[i].x;
+			if (cloud[i].y > l->domain[2].y) l->domain[2].y = cloud[i].y;
+		}
+		l->domain[1].x = l->domain[2].x; l->domain[1].y = l->domain[0].y;
+		l->domain[3].x = l->domain[0].x; l->domain[3].y = l->domain[2].y;
+	}
+	else {
+		l->n_domain = n_domain;
+		l->domain   = (point_t *)lloyd_alloc(n_domain * sizeof(point_t));
+		memcpy(l->domain, domain, n_domain * sizeof(point_t));
+	}
+
+	set_frame(l);
+	l->ct = create_sweephull_corner_table(l->points, n + 4);
+
+	l->center   = (point_t *)lloyd_alloc(l->ct->n_triangles * sizeof(point_t));
+	l->corner   = (uint32_t *)lloyd_alloc(n * sizeof(uint32_t));
+	l->centroid = (point_t *)lloyd_alloc(n * sizeof(point_t));
+	l->previous = (point_t *)lloyd_alloc(n * sizeof(point_t));
+	l->halvings = (unsigned char *)lloyd_alloc(n);
+	l->stack     = NULL;
+	l->n_stack   = 0;
+	l->max_stack = 0;
+
+	l->n_threads = (n_threads < 1) ? 1 : n_threads;
+	l->workers   = (lloyd_worker_t *)lloyd_alloc(l->n_threads * sizeof(lloyd_worker_t));
+	for (i=0; i < l->n_threads; i++) {
+		l->workers[i].l         = l;
+		l->workers[i].poly      = NULL;
+		l->workers[i].tmp       = NULL;
+		l->workers[i].max_poly  = 0;
+		l->workers[i].found     = NULL;
+		l->workers[i].n_found   = 0;
+		l->workers[i].max_found = 0;
+	}
+
+	return l;
+}
+
+void destroy_lloyd(lloyd_t *l)
+{
+	int i;
+
+	if (l == NULL) return;
+
+	for (i=0; i < l->n_threads; i++) {
+		free(l->workers[i].poly);
+		free(l->workers[i].tmp);
+		free(l->workers[i].found);
+	}
+	free(l->workers);
+	destroy_corner_table(l->ct);
+	free(l->points);
+	free(l->domain);
+	free(l->center);
+	free(l->corner);
+	free(l->centroid);
+	free(l->previous);
+	free(l->halvings);
+	free(l->stack);
+	free(l);
+}
+
+double lloyd_iteration(lloyd_t *l)
+{
+	double max_move = 0;
+	uint32_t i;
+	int t;
+
+	find_corners(l);
+	for (i=0; i < l->n; i++) /* Not in the triangulation (duplicates) */
+		if (l->corner[i] == NO_CORNER) l->centroid[i] = l->points[i];
+	run_phase(l, center_phase);
+	for (t=0; t < l->n_threads; t++) l->workers[t].max_move = 0;
+	run_phase(l, cell_phase);
+	for (t=0; t < l->n_threads; t++)
+		if (l->workers[t].max_move > max_move) max_move = l->workers[t].max_move;
+
+	memcpy(l->previous, l->points, l->n * sizeof(point_t));
+	memcpy(l->points, l->centroid, l->n * sizeof(point_t));
+	memset(l->halvings, 0, l->n);
+	hold_back(l);
+	flip_edges(l);
+
+	memcpy(l->cloud, l->points, l->n * sizeof(point_t));
+	return sqrt(max_move);
+}
+
+int lloyd_relaxation(lloyd_t *l, double tolerance, int max_iterations)
+{
+	int i;
+
+	for (i=0; i < max_iterations; i++)
+		if (lloyd_iteration(l) <= tolerance) return i+1;
+	return i;
+}
+
+corner_table_t *lloyd_triangulation(lloyd_t *l)
+{
+	return create_sweephull_corner_table(l->cloud, (int)l->n);
+}
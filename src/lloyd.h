@@ -0,0 +1,25 @@
+/* Lloyd relaxation: every point of the cloud is moved to the centroid of
+   its Voronoi cell, clipped to a convex domain. The Delaunay triangulation
+   of the points is kept from one iteration to the next and repaired by
+   edge flips */
+typedef struct lloyd_s lloyd_t;
+
+/* Relaxation of the n points of cloud, moved in place, inside the convex
+   polygon domain (n_domain vertices in direct order, the bounding box of
+   cloud if NULL). The cells are shared by n_threads workers. NULL if
+   there are no points or the domain has less than 3 vertices */
+lloyd_t *init_lloyd(point_t *cloud, int n, point_t *domain, int n_domain, int n_threads);
+void destroy_lloyd(lloyd_t *l);
+
+/* One iteration. Returns the largest distance from a point to its
+   centroid: moves inverting triangles are shortened or put off */
+double lloyd_iteration(lloyd_t *l);
+
+/* Iterations until no point moves by more than tolerance, at most
+   max_iterations of them. Returns the number of iterations done */
+int lloyd_relaxation(lloyd_t *l, double tolerance, int max_iterations);
+
+/* Delaunay triangulation of the current points (a corner table indexing
+   cloud, to destroy by the caller). NULL if they are all collinear */
+corner_table_t *lloyd_triangulation(lloyd_t *l);
+
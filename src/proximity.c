@@ -0,0 +1,283 @@
+/*
+    Proximity graphs extracted from a Delaunay triangulation
+
+    The Euclidean minimum spanning tree, the relative neighborhood graph
+    and the Gabriel graph are subgraphs of the Delaunay triangulation
+    (EMST <= RNG <= Gabriel <= Delaunay), so only its O(n) edges need to
+    be looked at.
+
+    - EMST: Kruskal on the edges sorted by length, with a union-find.
+    - Gabriel: a Delaunay edge is kept if the two vertices facing it are
+      not strictly inside its diametral circle.
+    - RNG: a Gabriel edge a-b is kept if no point is strictly inside the
+      lune of a and b. The points closer to a than b are connected through
+      Delaunay edges, so they are found by a search from a that stops at
+      distance |ab|.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "global.h"
+#include "delaunay.h"
+#include "quadedge.h"
+#include "ctable.h"
+#include "proximity.h"
+
+#define CHUNK 1024 /* Edges taken at once by a worker */
+
+typedef struct {
+	double d;
+	uint32_t c;
+} sorted_edge_t;
+
+typedef struct filter_s filter_t;
+
+typedef struct {
+	filter_t *f;
+	uint32_t *mark;   /* 1 + last edge whose lune search reached each vertex */
+	uint32_t *stack;
+} filter_worker_t;
+
+struct filter_s {
+	corner_table_t *ct;
+	ct_adjacency_t a;
+	uint32_t *corner; /* Corner standing for each Delaunay edge */
+	uint32_t n;
+	char *keep;
+	int (*test)(filter_worker_t *w, uint32_t e);
+	volatile int next;
+};
+
+static void *proximity_alloc(size_t size)
+{
+	void *p;
+
+	if ((p = malloc(size)) == NULL) {
+		fprintf(stderr, "Unable to allocate proximity graph\n");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+static double dist2(point_t *a, point_t *b)
+{
+	return (a->x - b->x)*(a->x - b->x) + (a->y - b->y)*(a->y - b->y);
+}
+
+/* One corner per edge, see CT_EDGE_CORNER() */
+static uint32_t *edge_corners(corner_table_t *ct, uint32_t *n)
+{
+	uint32_t *corner = (uint32_t *)proximity_alloc((3*ct->n_triangles + 1) * sizeof(uint32_t));
+	uint32_t c;
+
+	*n = 0;
+	for (c=0; c < 3*ct->n_triangles; c++)
+		if (CT_EDGE_CORNER(ct, c)) corner[(*n)++] = c;
+	return corner;
+}
+
+static void set_edge(corner_table_t *ct, uint32_t *edges, uint32_t i, uint32_t c)
+{
+	edges[2*i]   = ct->v[CT_NEXT(c)];
+	edges[2*i+1] = ct->v[CT_PREV(c)];
+}
+
+uint32_t *delaunay_edges(corner_table_t *ct, uint32_t *n_edges)
+{
+	uint32_t *corner = edge_corners(ct, n_edges), *edges, i;
+
+	edges = (uint32_t *)proximity_alloc((2 * *n_edges + 1) * sizeof(uint32_t));
+	for (i=0; i < *n_edges; i++) set_edge(ct, edges, i, corner[i]);
+
+	free(corner);
+	return edges;
+}
+
+static int compare_edges(const void *a, const void *b)
+{
+	double da = ((sorted_edge_t *)a)->d, db = ((sorted_edge_t *)b)->d;
+
+	return (da < db) ? -1 : (da > db);
+}
+
+static uint32_t find_root(uint32_t *parent, uint32_t i)
+{
+	uint32_t root = i, next;
+
+	while (parent[root] != root) root = parent[root];
+	while (parent[i] != root) { /* Path compression */
+		next = parent[i];
+		parent[i] = root;
+		i = next;
+	}
+	return root;
+}
+
+uint32_t *emst_edges(corner_table_t *ct, uint32_t *n_edges)
+{
+	uint32_t *corner, *parent, *edges, n, i, a, b;
+	unsigned char *rank;
+	sorted_edge_t *sorted;
+	point_t *cloud = ct->cloud;
+
+	corner = edge_corners(ct, &n);
+	sorted = (sorted_edge_t *)proximity_alloc((n+1) * sizeof(sorted_edge_t));
+	for (i=0; i < n; i++) {
+		sorted[i].c = corner[i];
+		sorted[i].d = dist2(cloud + ct->v[CT_NEXT(corner[i])], cloud + ct->v[CT_PREV(corner[i])]);
+	}
+	free(corner);
+	qsort(sorted, n, sizeof(sorted_edge_t), compare_edges);
+
+	parent = (uint32_t *)proximity_alloc((ct->n_vertices+1) * sizeof(uint32_t));
+	rank   = (unsigned char *)proximity_alloc(ct->n_vertices+1);
+	for (i=0; i < ct->n_vertices; i++) {
+		parent[i] = i;
+		rank[i]   = 0;
+	}
+
+	edges = (uint32_t *)proximity_alloc((2*ct->n_vertices + 1) * sizeof(uint32_t));
+	*n_edges = 0;
+	for (i=0; i < n; i++) {
+		a = find_root(parent, ct->v[CT_NEXT(sorted[i].c)]);
+		b = find_root(parent, ct->v[CT_PREV(sorted[i].c)]);
+		if (a == b) continue;
+
+		if (rank[a] < rank[b]) parent[a] = b;
+		else if (rank[a] > rank[b]) parent[b] = a;
+		else {
+			parent[b] = a;
+			rank[a]++;
+		}
+		set_edge(ct, edges, (*n_edges)++, sorted[i].c);
+	}
+
+	free(sorted);
+	free(parent);
+	free(rank);
+	return edges;
+}
+
+/* p strictly inside the circle of diameter a-b */
+static int in_diametral_circle(point_t *a, point_t *b, point_t *p)
+{
+	return ((a->x - p->x)*(b->x - p->x) + (a->y - p->y)*(b->y - p->y) < 0);
+}
+
+static int is_gabriel(filter_worker_t *w, uint32_t e)
+{
+	corner_table_t *ct = w->f->ct;
+	uint32_t c = w->f->corner[e];
+	point_t *a = ct->cloud + ct->v[CT_NEXT(c)], *b = ct->cloud + ct->v[CT_PREV(c)];
+
+	if (in_diametral_circle(a, b, ct->cloud + ct->v[c])) return 0;
+	if (ct->o[c] != NO_CORNER && in_diametral_circle(a, b, ct->cloud + ct->v[ct->o[c]])) return 0;
+	return 1;
+}
+
+static int is_rng(filter_worker_t *w, uint32_t e)
+{
+	corner_table_t *ct = w->f->ct;
+	ct_adjacency_t *adj = &w->f->a;
+	uint32_t c = w->f->corner[e], a = ct->v[CT_NEXT(c)], b = ct->v[CT_PREV(c)];
+	uint32_t top = 0, u, j, s;
+	point_t *cloud = ct->cloud;
+	double d = dist2(cloud + a, cloud + b);
+
+	if (!is_gabriel(w, e)) return 0;
+
+	w->mark[a] = e+1;
+	w->stack[top++] = a;
+	while (top > 0) {
+		u = w->stack[--top];
+		for (j = adj->first[u]; j < adj->first[u+1]; j++) {
+			if (w->mark[s = adj->adj[j]] == e+1) continue;
+			w->mark[s] = e+1;
+			if (dist2(cloud + a, cloud + s) >= d) continue;
+			if (dist2(cloud + b, cloud + s) < d) return 0; /* In the lune */
+			w->stack[top++] = s;
+		}
+	}
+
+	return 1;
+}
+
+static void *filter_worker(void *arg)
+{
+	filter_worker_t *w = (filter_worker_t *)arg;
+	filter_t *f = w->f;
+	int i, first;
+
+	while ((first = __sync_fetch_and_add(&f->next, CHUNK)) < (int)f->n) {
+		for (i=first; i < first + CHUNK && i < (int)f->n; i++)
+			f->keep[i] = (char)f->test(w, (uint32_t)i);
+	}
+
+	return NULL;
+}
+
+/* Delaunay edges passing test, checked by n_threads workers */
+static uint32_t *filter_edges(corner_table_t *ct, int n_threads, int (*test)(filter_worker_t *, uint32_t),
+                              uint32_t *n_edges)
+{
+	filter_worker_t *workers;
+	pthread_t *threads;
+	uint32_t *edges, i;
+	filter_t f;
+	int t;
+
+	if (n_threads < 1) n_threads = 1;
+
+	f.ct     = ct;
+	f.corner = edge_corners(ct, &f.n);
+	f.keep   = (char *)proximity_alloc(f.n + 1);
+	f.test   = test;
+	f.next   = 0;
+	if (test == is_rng) ct_build_adjacency(ct, &f.a);
+
+	workers = (filter_worker_t *)proximity_alloc(n_threads * sizeof(filter_worker_t));
+	threads = (pthread_t *)proximity_alloc(n_threads * sizeof(pthread_t));
+
+	for (t=0; t < n_threads; t++) {
+		workers[t].f     = &f;
+		workers[t].mark  = NULL;
+		workers[t].stack = NULL;
+		if (test == is_rng) {
+			workers[t].mark  = (uint32_t *)proximity_alloc((ct->n_vertices+1) * sizeof(uint32_t));
+			workers[t].stack = (uint32_t *)proximity_alloc((ct->n_vertices+1) * sizeof(uint32_t));
+			for (i=0; i < ct->n_vertices; i++) workers[t].mark[i] = 0;
+		}
+		if (pthread_create(&threads[t], NULL, filter_worker, &workers[t]) != 0) {
+			fprintf(stderr, "Unable to start proximity graph worker %d\n", t);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (t=0; t < n_threads; t++) {
+		pthread_join(threads[t], NULL);
+		free(workers[t].mark);
+		free(workers[t].stack);
+	}
+
+	edges = (uint32_t *)proximity_alloc((2*f.n + 1) * sizeof(uint32_t));
+	*n_edges = 0;
+	for (i=0; i < f.n; i++)
+		if (f.keep[i]) set_edge(ct, edges, (*n_edges)++, f.corner[i]);
+
+	if (test == is_rng) ct_free_adjacency(&f.a);
+	free(f.corner);
+	free(f.keep);
+	free(threads);
+	free(workers);
+	return edges;
+}
+
+uint32_t *gabriel_edges(corner_table_t *ct, int n_threads, uint32_t *n_edges)
+{
+	return filter_edges(ct, n_threads, is_gabriel, n_edges);
+}
+
+uint32_t *rng_edges(corner_table_t *ct, int n_threads, uint32_t *n_edges)
+{
+	return filter_edges(ct, n_threads, is_rng, n_edges);
+}
@@ -0,0 +1,16 @@
+/* Subgraphs of the Delaunay triangulation ct. Each function returns its
+   edges as pairs of vertex indices (edges[2*i], edges[2*i+1]) in an array
+   to be freed by the caller, and their number in *n_edges */
+
+/* Every edge of ct once */
+uint32_t *delaunay_edges(corner_table_t *ct, uint32_t *n_edges);
+
+/* Euclidean minimum spanning tree (a forest if ct is not connected) */
+uint32_t *emst_edges(corner_table_t *ct, uint32_t *n_edges);
+
+/* Gabriel graph: no point in the circle having the edge as diameter */
+uint32_t *gabriel_edges(corner_table_t *ct, int n_threads, uint32_t *n_edges);
+
+/* Relative neighborhood graph: no point closer to both extremities than
+   they are to each other */
+uint32_t *rng_edges(corner_table_t *ct, int n_threads, uint32_t *n_edges);
@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include "global.h"
 #include "quadedge.h"
+#include "alloc.h"
 
 /* Getters */
 quadedge_t *onext(quadedge_t *q) {
@@ -56,7 +58,7 @@ quadedge_t *lprev(quadedge_t *q) {
 quadedge_t *new_quadedge(quadedge_t *onext, quadedge_t *dual, point_t *orig) {
 	quadedge_t *q;
 
-	if ( (q = (quadedge_t *)malloc(sizeof(quadedge_t))) == NULL) {
+	if ( (q = (quadedge_t *)mesh_alloc(sizeof(quadedge_t))) == NULL) {
 		fprintf(stderr, "Unable to allocate memory for quadedge element\n");
 		exit(EXIT_FAILURE);
 	}
@@ -68,6 +70,42 @@ quadedge_t *new_quadedge(quadedge_t *onext, quadedge_t *dual, point_t *orig) {
 	return q;
 }
 
+/* Undo log: changes made since the first checkpoint, undone backwards */
+typedef enum { LOG_MAKE_EDGE, LOG_SPLICE, LOG_ORIG, LOG_DELETE } log_op_t;
+
+typedef struct {
+	log_op_t op;
+	quadedge_t *a;
+	quadedge_t *b;      /* LOG_SPLICE: other edge, LOG_DELETE: former list head */
+	point_t *orig;      /* LOG_ORIG: former origin */
+} log_entry_t;
+
+static log_entry_t *undo_log = NULL;
+static int n_log = 0;
+static int max_log = 0;
+static int logging = 0;
+
+static void log_change(log_op_t op, quadedge_t *a, quadedge_t *b, point_t *orig) {
+	if (n_log == max_log) {
+		max_log = max_log ? 2*max_log : 1024;
+		if ((undo_log = (log_entry_t *)realloc(undo_log, max_log*sizeof(log_entry_t))) == NULL) {
+			fprintf(stderr, "Unable to allocate undo log\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	undo_log[n_log].op   = op;
+	undo_log[n_log].a    = a;
+	undo_log[n_log].b    = b;
+	undo_log[n_log].orig = orig;
+	n_log++;
+}
+
+/* Atomic: concurrent.c reads the origin of an edge before claiming it */
+static void set_orig(quadedge_t *q, point_t *p) {
+	if (logging) log_change(LOG_ORIG, q, NULL, q->orig);
+	__atomic_store_n(&q->orig, p, __ATOMIC_RELAXED);
+}
+
 quadedge_t *make_edge(point_t *orig, point_t *dest) {
 	quadedge_t *q0, *q1, *q2, *q3;
 
@@ -84,6 +122,7 @@ quadedge_t *make_edge(point_t *orig, point_t *dest) {
 	q0->dual = q1; q1->dual = q2; 
 	q2->dual = q3; q3->dual = q0;
 
+	if (logging) log_change(LOG_MAKE_EDGE, q0, NULL, NULL);
 	return q0;
 }
 
@@ -96,6 +135,7 @@ void splice(quadedge_t *a, quadedge_t *b) {
 	quadedge_t *t3    = onext(beta);
 	quadedge_t *t4    = onext(alpha);
 
+	if (logging) log_change(LOG_SPLICE, a, b, NULL);
 	a->onext = t1;
 	b->onext = t2;
 	alpha->onext = t3;
@@ -120,66 +160,378 @@ void swap_edge(quadedge_t *e) {
 	splice(sym(e), b);
 	splice(e, lnext(a));
 	splice(sym(e), lnext(b));
-	e->orig = dest(a);
+	set_orig(e, dest(a));
 	c = sym(e);
-	c->orig = dest(b);
+	set_orig(c, dest(b));
 }
 
+/* Deleted edges are only unlinked: walks may still hold them as a starting
+   point. They are marked (orig == NULL) and freed by collect_deleted_edges() */
+static quadedge_t *deleted_edges = NULL;
+
 void delete_edge(quadedge_t *q) {
+	quadedge_t *head;
+
 	splice(q, oprev(q));
 	splice(sym(q), oprev(sym(q)));
 
-	free(q);
+	set_orig(q, NULL);
+	set_orig(sym(q), NULL);
+	do {
+		head = deleted_edges;
+		q->onext = head;
+	} while (!__sync_bool_compare_and_swap(&deleted_edges, head, q));
+	if (logging) log_change(LOG_DELETE, q, head, NULL);
+}
+
+int is_deleted(quadedge_t *q) {
+	return (q->orig == NULL);
+}
+
+void collect_deleted_edges(void) {
+	quadedge_t *q, *r;
+	int i;
+
+	if (logging) return; /* A rollback may bring them back */
+	while (deleted_edges != NULL) {
+		q = deleted_edges;
+		deleted_edges = q->onext;
+		for (i=0; i<4; i++) {
+			r = q->dual;
+			mesh_free(q);
+			q = r;
+		}
+	}
+}
+
+int checkpoint_quadedges(void) {
+	logging = 1;
+	return n_log;
+}
+
+void rollback_quadedges(int mark) {
+	quadedge_t *q, *r;
+	log_entry_t *l;
+	int i;
+
+	logging = 0;
+	while (n_log > mark) {
+		l = &undo_log[--n_log];
+		switch (l->op) {
+		case LOG_MAKE_EDGE: /* Alone again: its splices are undone */
+			for (i=0, q = l->a; i<4; i++, q = r) {
+				r = q->dual;
+				mesh_free(q);
+			}
+			break;
+		case LOG_SPLICE:
+			splice(l->a, l->b);
+			break;
+		case LOG_ORIG:
+			l->a->orig = l->orig;
+			break;
+		case LOG_DELETE:
+			deleted_edges = l->b;
+			l->a->onext = l->a; /* As left by the splices */
+			break;
+		}
+	}
+	logging = 1;
+}
+
+void release_checkpoints(void) {
+	logging = 0;
+	n_log = 0;
+}
+
+int has_checkpoint(void) {
+	return logging;
+}
+
+static quadedge_t **grow_edge_set(quadedge_t **set, int *size) {
+	quadedge_t **bigger;
+	int i, new_size = 2 * *size;
+	size_t h;
+
+	if ((bigger = (quadedge_t **)calloc(new_size, sizeof(quadedge_t *))) == NULL) {
+		fprintf(stderr, "Unable to allocate memory for edge enumeration\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (i=0; i < *size; i++) {
+		if (set[i] == NULL) continue;
+		h = (((size_t)set[i] >> 4) * 2654435761u >> 8) & (new_size - 1);
+		while (bigger[h] != NULL) h = (h + 1) & (new_size - 1);
+		bigger[h] = set[i];
+	}
+
+	free(set);
+	*size = new_size;
+	return bigger;
+}
+
+/* Every primal quadedge (both directions of each edge) reachable from start.
+   The returned array must be freed by the caller */
+quadedge_t **collect_edges(quadedge_t *start, int *n) {
+	quadedge_t **edges, **set, *e, *next[3];
+	int max = 1024, size = 4096, count = 0, i, j;
+	size_t h;
+
+	edges = (quadedge_t **)malloc(max * sizeof(quadedge_t *));
+	set   = (quadedge_t **)calloc(size, sizeof(quadedge_t *));
+	if (edges == NULL || set == NULL) {
+		fprintf(stderr, "Unable to allocate memory for edge enumeration\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* edges[] doubles as the stack of edges to visit: edges[i] is
+	   visited when i reaches it, new edges are appended */
+	edges[count++] = start;
+	set[(((size_t)start >> 4) * 2654435761u >> 8) & (size - 1)] = start;
+
+	for (i=0; i < count; i++) {
+		next[0] = sym(edges[i]);
+		next[1] = onext(edges[i]);
+		next[2] = lnext(edges[i]);
+
+		for (j=0; j < 3; j++) {
+			e = next[j];
+			h = (((size_t)e >> 4) * 2654435761u >> 8) & (size - 1);
+			while (set[h] != NULL && set[h] != e) h = (h + 1) & (size - 1);
+			if (set[h] == e) continue;
+			set[h] = e;
+
+			if (count == max) {
+				max *= 2;
+				if ((edges = (quadedge_t **)realloc(edges, max * sizeof(quadedge_t *))) == NULL) {
+					fprintf(stderr, "Unable to allocate memory for edge enumeration\n");
+					exit(EXIT_FAILURE);
+				}
+			}
+			edges[count++] = e;
+
+			if (2*count > size) set = grow_edge_set(set, &size);
+		}
+	}
+
+	free(set);
+	*n = count;
+	return edges;
+}
+
+/* Exact sums and products of doubles (Dekker, Knuth): x + err is exactly
+   a + b, or a * b */
+static double two_sum(double a, double b, double *err) {
+	double x = a + b, bv = x - a, av = x - bv;
+
+	*err = (a - av) + (b - bv);
+	return x;
+}
+
+static double two_product(double a, double b, double *err) {
+	double x = a * b;
+
+	*err = fma(a, b, -x);
+	return x;
+}
+
+/* *d = a - b, returns 0 if it was rounded */
+static int exact_difference(double a, double b, double *d) {
+	double lo;
+
+	*d = two_sum(a, -b, &lo);
+	return (lo == 0);
+}
+
+/* Adds b to the n components of e, smallest first and not overlapping.
+   Returns the new number of components (Shewchuk's grow_expansion) */
+static int grow_expansion(double *e, int n, double b) {
+	double q = b, h;
+	int i, m = 0;
+
+	for (i=0; i < n; i++) {
+		q = two_sum(q, e[i], &h);
+		if (h != 0) e[m++] = h;
+	}
+	if (q != 0) e[m++] = q;
+	return m;
+}
+
+/* Twice the signed area of a, b, c, positive in direct order. Its sign is
+   exact: when the rounded determinant is too small to be trusted, it is
+   summed again without rounding, from two products if the differences are
+   exact (points on a grid), from its six products otherwise. is_on_line()
+   and is_counter_clockwise() can then never disagree, nor depend on the
+   order of the points */
+static double orientation(point_t *a, point_t *b, point_t *c) {
+	double left  = (b->x - a->x)*(c->y - a->y);
+	double right = (b->y - a->y)*(c->x - a->x);
+	double det = left - right, bound = 3.3306690738754716e-16 * (fabs(left) + fabs(right));
+	double f[3][2], e[12], lo, ux, uy, vx, vy;
+	int i, n = 0;
+
+	if (det > bound || -det > bound) return det;
+
+	/* Exact differences (points on a grid): two exact products */
+	if (exact_difference(b->x, a->x, &ux) && exact_difference(c->y, a->y, &vy) &&
+	    exact_difference(b->y, a->y, &uy) && exact_difference(c->x, a->x, &vx)) {
+		n = grow_expansion(e, n, two_product(ux, vy, &lo));
+		n = grow_expansion(e, n, lo);
+		n = grow_expansion(e, n, -two_product(uy, vx, &lo));
+		n = grow_expansion(e, n, -lo);
+		return n ? e[n-1] : 0;
+	}
+
+	/* ax (by - cy) + bx (cy - ay) + cx (ay - by) */
+	f[0][0] = a->x; f[0][1] = b->y; f[1][0] = b->x; f[1][1] = c->y; f[2][0] = c->x; f[2][1] = a->y;
+	for (i=0; i < 3; i++) {
+		n = grow_expansion(e, n, two_product(f[i][0], f[i][1], &lo));
+		n = grow_expansion(e, n, lo);
+		n = grow_expansion(e, n, -two_product(f[(i+2)%3][0], f[i][1], &lo));
+		n = grow_expansion(e, n, -lo);
+	}
+	return n ? e[n-1] : 0;
 }
 
 int is_on_line(quadedge_t *e, point_t *p) {
-	if ((p->x-e->orig->x)*(p->y-dest(e)->y) == (p->y-e->orig->y)*(p->x-dest(e)->x))
-		return 1;
-	return 0;
+	return (orientation(e->orig, dest(e), p) == 0);
 }
 
 int is_counter_clockwise(point_t *a, point_t *b, point_t *c) {
-	if ( (a->x - b->x)*(b->y - c->y) > (a->y - b->y)*(b->x - c->x) ) 
-		return 1;
-	return 0;
+	return (orientation(a, b, c) > 0);
 }
 
 int is_at_right_of(quadedge_t *q, point_t *p) {
 	return is_counter_clockwise(p, dest(q), q->orig);
 }
 
-static double det33(m0, m1, m2, m3, m4, m5, m6, m7, m8)
-{
-	double det33 = 0;
+/* Multiplies the n components of e by b, into h (Shewchuk's
+   scale_expansion). Returns the number of components of h */
+static int scale_expansion(double *e, int n, double b, double *h) {
+	double q, t, lo, hh;
+	int i, m = 0;
+
+	q = two_product(e[0], b, &hh);
+	if (hh != 0) h[m++] = hh;
+	for (i=1; i < n; i++) {
+		t = two_product(e[i], b, &lo);
+		q = two_sum(q, lo, &hh);
+		if (hh != 0) h[m++] = hh;
+		q = two_sum(t, q, &hh);
+		if (hh != 0) h[m++] = hh;
+	}
+	if (q != 0 || m == 0) h[m++] = q;
+	return m;
+}
+
+/* Adds sign times the determinant of the rows (x, y, x^2 + y^2) of the
+   three points to the expansion sum: its 12 monomials, products of four
+   coordinates, without rounding. Returns the new length of sum */
+static int add_lifted_minor(double *sum, int n, double sign, double x[3], double y[3]) {
+	static const int perm[6][3] = { {0,1,2}, {1,2,0}, {2,0,1}, {0,2,1}, {2,1,0}, {1,0,2} };
+	double term[8], tmp[8], z;
+	int i, j, lift, len;
+
+	for (i=0; i < 6; i++) {
+		for (lift=0; lift < 2; lift++) {
+			/* x of row perm[0], y of row perm[1], x^2 or y^2 of row perm[2] */
+			z = lift ? y[perm[i][2]] : x[perm[i][2]];
+			term[0] = (i < 3 ? sign : -sign) * x[perm[i][0]];
+			len = scale_expansion(term, 1, y[perm[i][1]], tmp);
+			len = scale_expansion(tmp, len, z, term);
+			len = scale_expansion(term, len, z, tmp);
+			for (j=0; j < len; j++) n = grow_expansion(sum, n, tmp[j]);
+		}
+	}
+	return n;
+}
 
-	det33 += m0 * (m4*m8 - m5*m7);
-	det33 -= m1 * (m3*m8 - m5*m6);
-	det33 += m2 * (m3*m7 - m4*m6);
+static int exact_product(double a, double b, double *p) {
+	double lo;
 
-	return det33;
+	*p = two_product(a, b, &lo);
+	return (lo == 0);
 }
 
-/* Tests if point d is inside the circumcenter of triangle a, b, c
-		 if "d" is strictly INSIDE the circle, then
- 
-		     |d² dx dy 1||
-             |a² ax ay 1||
-		 det |b² bx by 1|  <  0
-		     |c² cx cy 1|
- 
-	There is probably a faster way to implement this test */
+static int exact_sum(double a, double b, double *s) {
+	double lo;
+
+	*s = two_sum(a, b, &lo);
+	return (lo == 0);
+}
+
+/* The lifted determinant of add_lifted_minor() in doubles, 0 if one of
+   the operations was rounded (it seldom is on a grid) */
+static int lifted_minor_in_doubles(double x[3], double y[3], double *det) {
+	double lift[3], minor[3], t, u;
+	int i, j, k, exact = 1;
+
+	for (i=0; i < 3; i++) {
+		j = (i+1) % 3;
+		k = (i+2) % 3;
+		exact = exact_product(x[i], x[i], &t) && exact_product(y[i], y[i], &u) &&
+		        exact_sum(t, u, &lift[i]) && exact;
+		exact = exact_product(x[j], y[k], &t) && exact_product(x[k], y[j], &u) &&
+		        exact_sum(t, -u, &minor[i]) && exact;
+		if (!exact) return 0;
+	}
+	return exact_product(lift[0], minor[0], &t) && exact_product(lift[1], minor[1], &u) &&
+	       exact_sum(t, u, &t) && exact_product(lift[2], minor[2], &u) &&
+	       exact_sum(t, u, det);
+}
+
+/* Exact sign of the in-circle determinant, only called when the rounded
+   one cannot be trusted. If the differences to d are exact (points on a
+   grid), the 3x3 determinant of the translated points is enough; the 4x4
+   one expands to four of them otherwise */
+static double incircle_exact(point_t *a, point_t *b, point_t *c, point_t *d) {
+	point_t *p[4];
+	double x[3], y[3], sum[512], det;
+	int i, j, k, n = 0, exact = 1;
+
+	p[0] = a; p[1] = b; p[2] = c; p[3] = d;
+	for (i=0; i < 3; i++) {
+		exact = exact_difference(p[i]->x, d->x, &x[i]) && exact;
+		exact = exact_difference(p[i]->y, d->y, &y[i]) && exact;
+	}
+	if (exact) {
+		if (lifted_minor_in_doubles(x, y, &det)) return det;
+		n = add_lifted_minor(sum, n, 1, x, y);
+		return n ? sum[n-1] : 0;
+	}
+
+	/* Along the column of ones: the minor without row i, sign (-1)^(i+1) */
+	for (i=0; i < 4; i++) {
+		for (j=0, k=0; j < 4; j++) {
+			if (j == i) continue;
+			x[k] = p[j]->x;
+			y[k] = p[j]->y;
+			k++;
+		}
+		n = add_lifted_minor(sum, n, (i % 2) ? 1 : -1, x, y);
+	}
+	return n ? sum[n-1] : 0;
+}
+
+/* Tests if point d is strictly inside the circumcircle of the direct
+   triangle a, b, c. The rounded determinant is used when it is larger
+   than its error bound (Shewchuk's), the exact one otherwise: cocircular
+   points are never inside, and the answer does not depend on the order
+   of a, b, c */
 int incircle(point_t *a, point_t *b, point_t *c, point_t *d) {
-	double a2 = a->x*a->x + a->y*a->y;
-	double b2 = b->x*b->x + b->y*b->y;
-	double c2 = c->x*c->x + c->y*c->y;
-	double d2 = d->x*d->x + d->y*d->y;
-
-	double det44 = 0;
-	det44 += d2   * det33( a->x, a->y,    1, b->x, b->y,    1, c->x, c->y,    1);
-	det44 -= d->x * det33( a2,   a->y,    1, b2,   b->y,    1, c2,   c->y,    1);
-	det44 += d->y * det33( a2,   a->x,    1, b2,   b->x,    1, c2,   c->x,    1);
-	det44 -= 1    * det33( a2,   a->x, a->y, b2,   b->x, b->y, c2,   c->y, c->y);
-
-	if (det44 < 0) return 1;
-	return 0;
+	double adx = a->x - d->x, ady = a->y - d->y;
+	double bdx = b->x - d->x, bdy = b->y - d->y;
+	double cdx = c->x - d->x, cdy = c->y - d->y;
+	double ad = adx*adx + ady*ady, bd = bdx*bdx + bdy*bdy, cd = cdx*cdx + cdy*cdy;
+	double det, bound;
+
+	det = ad*(bdx*cdy - cdx*bdy) + bd*(cdx*ady - adx*cdy) + cd*(adx*bdy - bdx*ady);
+	bound = (fabs(bdx*cdy) + fabs(cdx*bdy)) * ad
+	      + (fabs(cdx*ady) + fabs(adx*cdy)) * bd
+	      + (fabs(adx*bdy) + fabs(bdx*ady)) * cd;
+	bound *= 1.1102230246251577e-15;
+
+	if (det > bound) return 1;
+	if (-det > bound) return 0;
+	return (incircle_exact(a, b, c, d) > 0);
 }
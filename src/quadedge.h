@@ -46,6 +46,28 @@ void swap_edge(quadedge_t *e);
 
 void delete_edge(quadedge_t *q);
 
+/* Primal quadedge removed by delete_edge() and not yet collected */
+int is_deleted(quadedge_t *q);
+
+/* Frees deleted edges - no walk may hold one of them anymore. Does nothing
+   while a checkpoint is kept */
+void collect_deleted_edges(void);
+
+/* From a checkpoint on, make_edge(), splice(), swap_edge() and
+   delete_edge() are logged. rollback_quadedges(mark) undoes the changes
+   made since the checkpoint that returned mark, in reverse order, and
+   keeps logging; release_checkpoints() keeps the changes and stops. Not
+   for concurrent insertion */
+int checkpoint_quadedges(void);
+void rollback_quadedges(int mark);
+void release_checkpoints(void);
+
+/* The changes are being logged */
+int has_checkpoint(void);
+
+/* All primal quadedges reachable from start (to be freed by the caller) */
+quadedge_t **collect_edges(quadedge_t *start, int *n);
+
 int is_on_line(quadedge_t *e, point_t *p);
 
 int is_counter_clockwise(point_t *a, point_t *b, point_t *c);
@@ -0,0 +1,760 @@
+/*
+    Regression cases, without SDL: make regress && ./regress
+
+    Rotated grids are the worst case of the rounded predicates: every row
+    of points is almost, but not exactly, collinear. Each one must end in
+    triangles of positive area, 2n - 2 - h of them (h edges on the hull).
+    A time-sliced build cancelled halfway must leave nothing behind for the
+    next one.
+
+    The modules working on a triangulation are checked on random clouds,
+    against brute force where there is one.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "global.h"
+#include "alloc.h"
+#include "delaunay.h"
+#include "quadedge.h"
+#include "ctable.h"
+#include "gb.h"
+#include "hierarchy.h"
+#include "sweephull.h"
+#include "small.h"
+#include "kinetic.h"
+#include "knn.h"
+#include "proximity.h"
+#include "alpha.h"
+#include "snapshot.h"
+#include "traverse.h"
+#include "lloyd.h"
+
+#define GRID 30
+#define SMALL_GRID 8 /* SMALL_MAX_POINTS */
+#define N_RANDOM 300
+#define KNN 8
+#define SNAPSHOT_PATH "regress.snapshot"
+#define N_SEGMENTS 200
+#define N_LLOYD 100
+
+typedef enum { QUADEDGE, HIERARCHY, SWEEPHULL, SMALL, LIST } engine_id_t;
+
+static const char *engine_names[] = { "quadedge", "hierarchy", "sweephull", "small", "list" };
+
+static void rotated_grid(point_t *cloud, int g, double degrees)
+{
+	double a = degrees * M_PI / 180, c = cos(a), s = sin(a);
+	int i, j;
+
+	for (j=0; j < g; j++)
+		for (i=0; i < g; i++) {
+			cloud[j*g+i].x = i*c - j*s;
+			cloud[j*g+i].y = i*s + j*c;
+		}
+}
+
+/* Same sequence on every run */
+static unsigned int random_seed = 1;
+
+static double random_unit(void)
+{
+	random_seed = random_seed * 1103515245 + 12345;
+	return ((random_seed >> 8) & 0xffffff) / 16777216.0;
+}
+
+static void random_cloud(point_t *cloud, int n, double size)
+{
+	int i;
+
+	for (i=0; i < n; i++) {
+		cloud[i].x = size * random_unit();
+		cloud[i].y = size * random_unit();
+	}
+}
+
+static corner_table_t *run_engine(engine_id_t engine, point_t *cloud, int n)
+{
+	corner_table_t *ct;
+	tl_elt *list;
+	int i;
+
+	if (engine == SMALL) {
+		ct = create_corner_table(cloud, n, SMALL_MAX_TRIANGLES);
+		ct->n_triangles = small_triangulation(cloud, n, ct->v, ct->o);
+		return ct;
+	}
+	if (engine == LIST) {
+		if ((list = create_delaunay_triangulation(cloud, n)) == NULL) return NULL;
+		ct = corner_table_from_list(list, cloud, n);
+		destroy_list(list);
+		return ct;
+	}
+	if (engine == SWEEPHULL) return create_sweephull_corner_table(cloud, n);
+
+	if (engine == HIERARCHY) {
+		init_hierarchy();
+		for (i=0; i < n; i++) hierarchy_insert_point(cloud+i);
+	}
+	else {
+		init_delaunay();
+		for (i=0; i < n; i++) insert_point(cloud+i);
+	}
+	return corner_table_from_quadedge(get_hull_edge(), cloud, n);
+}
+
+/* Every point used, every triangle in direct order */
+static int is_valid(corner_table_t *ct)
+{
+	uint32_t c, hull = 0;
+
+	for (c=0; c < 3*ct->n_triangles; c++) {
+		if (ct->o[c] == NO_CORNER) hull++;
+		if (c % 3 == 0 && !is_counter_clockwise(ct->cloud + ct->v[c], ct->cloud + ct->v[c+1],
+		                                        ct->cloud + ct->v[c+2]))
+			return 0;
+	}
+	return (ct->n_triangles == 2*ct->n_vertices - 2 - hull);
+}
+
+/* No vertex inside the circumcircle of a neighbor triangle */
+static int is_delaunay(corner_table_t *ct)
+{
+	uint32_t c, t;
+
+	for (c=0; c < 3*ct->n_triangles; c++) {
+		if (ct->o[c] == NO_CORNER) continue;
+		t = 3*(c/3);
+		if (incircle(ct->cloud + ct->v[t], ct->cloud + ct->v[t+1], ct->cloud + ct->v[t+2],
+		             ct->cloud + ct->v[ct->o[c]]))
+			return 0;
+	}
+	return 1;
+}
+
+static int check_grid(engine_id_t engine, double degrees)
+{
+	static point_t cloud[GRID*GRID];
+	corner_table_t *ct;
+	int g = (engine == SMALL) ? SMALL_GRID : GRID, valid;
+
+	rotated_grid(cloud, g, degrees);
+	ct = run_engine(engine, cloud, g*g);
+	valid = (ct != NULL && is_valid(ct));
+	destroy_corner_table(ct);
+	if (valid) return 0;
+
+	printf("%s, %dx%d grid rotated %g degrees: invalid triangulation\n",
+	       engine_names[engine], g, g, degrees);
+	return 1;
+}
+
+static int check_cancel(double degrees)
+{
+	static point_t cloud[GRID*GRID];
+	delaunay_build_t *b;
+	int left;
+
+	rotated_grid(cloud, GRID, degrees);
+	b = start_delaunay_build(cloud, GRID*GRID);
+	left = continue_delaunay_build(b, GRID*GRID/2, 0);
+	cancel_delaunay_build(b);
+	if (left > 0 && left < GRID*GRID)
+		return check_grid(LIST, degrees);
+
+	printf("list, %dx%d grid rotated %g degrees: %d points left after a slice\n",
+	       GRID, GRID, degrees, left);
+	return 1;
+}
+
+/* Vertices moved a little, then across the cloud: each round must leave a
+   Delaunay triangulation of all the points, at their new position unless
+   the move is reported as failed */
+static int check_kinetic(void)
+{
+	static point_t cloud[N_RANDOM], pos[N_RANDOM/10];
+	static int index[N_RANDOM/10];
+	corner_table_t *ct;
+	kinetic_t *k;
+	int round, i, j, m = N_RANDOM/10, failed = 0, valid;
+
+	random_cloud(cloud, N_RANDOM, 100);
+	init_delaunay();
+	for (i=0; i < N_RANDOM; i++) insert_point(cloud+i);
+	k = init_kinetic(cloud, N_RANDOM);
+
+	for (round=0; round < 20 && !failed; round++) {
+		for (i=0; i < m; i++) {
+			index[i] = (round*37 + i*11) % N_RANDOM;
+			if (round % 2 == 0) {
+				pos[i].x = cloud[index[i]].x + 6*random_unit() - 3;
+				pos[i].y = cloud[index[i]].y + 6*random_unit() - 3;
+			}
+			else
+				random_cloud(pos+i, 1, 100);
+		}
+		move_vertices(k, index, pos, m);
+
+		for (i=0; i < m; i++) {
+			for (j=0; j < k->n_failed && k->failed[j] != index[i]; j++);
+			if (j == k->n_failed && (cloud[index[i]].x != pos[i].x || cloud[index[i]].y != pos[i].y))
+				failed = 1;
+		}
+		ct = corner_table_from_quadedge(get_hull_edge(), cloud, N_RANDOM);
+		valid = (is_valid(ct) && is_delaunay(ct));
+		destroy_corner_table(ct);
+		if (!valid) failed = 1;
+	}
+	destroy_kinetic(k);
+
+	if (failed) printf("kinetic, round %d: moves lost or triangulation invalid\n", round);
+	return failed;
+}
+
+static double distance(point_t *a, point_t *b)
+{
+	return sqrt((a->x - b->x)*(a->x - b->x) + (a->y - b->y)*(a->y - b->y));
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+	double da = *(double *)a, db = *(double *)b;
+
+	return (da < db) ? -1 : (da > db);
+}
+
+/* The j-th neighbor of each vertex is as far as the j-th closest point */
+static int check_knn(void)
+{
+	static point_t cloud[N_RANDOM];
+	static uint32_t index[N_RANDOM*KNN];
+	static double dist[N_RANDOM*KNN], all[N_RANDOM];
+	corner_table_t *ct;
+	int i, j, n_all, failed = 0;
+
+	random_cloud(cloud, N_RANDOM, 100);
+	ct = create_sweephull_corner_table(cloud, N_RANDOM);
+	knn_graph(ct, KNN, 4, index, dist);
+
+	for (i=0; i < N_RANDOM && !failed; i++) {
+		for (j=0, n_all=0; j < N_RANDOM; j++)
+			if (j != i) all[n_all++] = distance(cloud+i, cloud+j);
+		qsort(all, n_all, sizeof(double), compare_doubles);
+		for (j=0; j < KNN; j++)
+			if (index[i*KNN+j] == KNN_NONE || fabs(dist[i*KNN+j] - all[j]) > 1e-9 ||
+			    fabs(distance(cloud+i, cloud+index[i*KNN+j]) - all[j]) > 1e-9)
+				failed = 1;
+	}
+	destroy_corner_table(ct);
+
+	if (failed) printf("knn, vertex %d: not the %d nearest neighbors\n", i-1, KNN);
+	return failed;
+}
+
+static double dot(point_t *p, point_t *a, point_t *b)
+{
+	return (a->x - p->x)*(b->x - p->x) + (a->y - p->y)*(b->y - p->y);
+}
+
+/* Brute force over the pairs of points: graph 0 Gabriel, 1 relative
+   neighborhood */
+static int is_proximity_edge(point_t *cloud, int n, int a, int b, int graph)
+{
+	double d = dot(cloud+a, cloud+b, cloud+b);
+	int p;
+
+	for (p=0; p < n; p++) {
+		if (p == a || p == b) continue;
+		if (graph == 0 && dot(cloud+p, cloud+a, cloud+b) < 0) return 0;
+		if (graph == 1 && dot(cloud+a, cloud+p, cloud+p) < d && dot(cloud+b, cloud+p, cloud+p) < d)
+			return 0;
+	}
+	return 1;
+}
+
+/* Prim's algorithm on the complete graph */
+static double brute_emst_length(point_t *cloud, int n)
+{
+	static double best[N_RANDOM];
+	static unsigned char in_tree[N_RANDOM];
+	double length = 0;
+	int i, j, next = 0;
+
+	for (i=0; i < n; i++) {
+		best[i] = -1;
+		in_tree[i] = 0;
+	}
+	for (i=0; i < n; i++) {
+		in_tree[next] = 1;
+		if (i > 0) length += best[next];
+		for (j=0; j < n; j++)
+			if (!in_tree[j] && (best[j] < 0 || distance(cloud+next, cloud+j) < best[j]))
+				best[j] = distance(cloud+next, cloud+j);
+		for (j=0, next = -1; j < n; j++)
+			if (!in_tree[j] && (next < 0 || best[j] < best[next])) next = j;
+	}
+	return length;
+}
+
+/* The EMST is as long as Prim's tree, the Gabriel and relative
+   neighborhood graphs have the same edges as brute force finds */
+static int check_proximity(void)
+{
+	static point_t cloud[N_RANDOM];
+	static unsigned char is_edge[N_RANDOM][N_RANDOM];
+	corner_table_t *ct;
+	uint32_t *edges, n_edges, i;
+	double length = 0;
+	int graph, a, b, wrong, failed = 0;
+
+	random_cloud(cloud, N_RANDOM, 100);
+	ct = create_sweephull_corner_table(cloud, N_RANDOM);
+
+	edges = emst_edges(ct, &n_edges);
+	for (i=0; i < n_edges; i++) length += distance(cloud + edges[2*i], cloud + edges[2*i+1]);
+	free(edges);
+	if (n_edges != N_RANDOM-1 || fabs(length - brute_emst_length(cloud, N_RANDOM)) > 1e-9) {
+		printf("proximity: %u edges in the EMST, length %.12f\n", n_edges, length);
+		failed = 1;
+	}
+
+	for (graph=0; graph < 2; graph++) {
+		edges = graph ? rng_edges(ct, 4, &n_edges) : gabriel_edges(ct, 4, &n_edges);
+		for (a=0; a < N_RANDOM; a++)
+			for (b=0; b < N_RANDOM; b++) is_edge[a][b] = 0;
+		for (i=0; i < n_edges; i++)
+			is_edge[edges[2*i]][edges[2*i+1]] = is_edge[edges[2*i+1]][edges[2*i]] = 1;
+		free(edges);
+
+		for (a=0, wrong=0; a < N_RANDOM && !wrong; a++)
+			for (b=a+1; b < N_RANDOM && !wrong; b++)
+				wrong = (is_edge[a][b] != is_proximity_edge(cloud, N_RANDOM, a, b, graph));
+		if (wrong) {
+			printf("proximity: edge %d-%d wrong in the %s graph\n", a-1, b-1,
+			       graph ? "relative neighborhood" : "Gabriel");
+			failed = 1;
+		}
+	}
+	destroy_corner_table(ct);
+
+	return failed;
+}
+
+/* Shape of alpha: as many triangles as the list has of circumradius <= alpha,
+   its boundary edges each once in the loops, every loop closed */
+static int check_alpha_shape(alpha_complex_t *a, tl_elt *list, point_t *cloud, int n, double alpha)
+{
+	static unsigned char is_boundary[N_RANDOM][N_RANDOM];
+	corner_table_t *ct = a->ct;
+	alpha_loops_t *l;
+	uint32_t cut = 0, n_boundary = 0, c, i, j, u, v;
+	tl_elt *tmp;
+	int failed = 0;
+
+	for (tmp = list; tmp != NULL; tmp = tmp->n)
+		if (is_cloud_triangle(tmp->t, cloud, n) && tmp->t->r <= alpha) cut++;
+	if (alpha_cut(a, alpha) != cut) failed = 1;
+
+	for (u=0; u < (uint32_t)n; u++)
+		for (v=0; v < (uint32_t)n; v++) is_boundary[u][v] = 0;
+	for (c=0; c < 3*ct->n_triangles; c++) {
+		if (a->r[c/3] > alpha || (ct->o[c] != NO_CORNER && a->r[ct->o[c]/3] <= alpha)) continue;
+		is_boundary[ct->v[CT_NEXT(c)]][ct->v[CT_PREV(c)]] = 1;
+		n_boundary++;
+	}
+
+	l = alpha_shape_loops(a, alpha);
+	if (l->first[l->n_loops] != n_boundary) failed = 1;
+	for (i=0; i < l->n_loops && !failed; i++)
+		for (j = l->first[i]; j < l->first[i+1]; j++) {
+			u = l->vertex[j];
+			v = l->vertex[j+1 < l->first[i+1] ? j+1 : l->first[i]];
+			if (!is_boundary[u][v]) failed = 1;
+			is_boundary[u][v] = 0; /* Each edge once */
+		}
+	destroy_alpha_loops(l);
+
+	if (failed) printf("alpha shape of %g: wrong triangles or outline\n", alpha);
+	return failed;
+}
+
+/* Shapes from none to all of the triangles, the last one outlined by the
+   convex hull */
+static int check_alpha(void)
+{
+	static point_t cloud[N_RANDOM], *hull[N_RANDOM];
+	alpha_complex_t *a;
+	alpha_loops_t *l;
+	tl_elt *list;
+	int k, n_hull, failed = 0;
+
+	random_cloud(cloud, N_RANDOM, 100);
+	list = create_delaunay_triangulation(cloud, N_RANDOM);
+	n_hull = get_convex_hull(hull);
+	a = create_alpha_complex(list, cloud, N_RANDOM);
+
+	for (k=0; k <= 8; k++)
+		failed += check_alpha_shape(a, list, cloud, N_RANDOM, k * 1.5);
+	failed += check_alpha_shape(a, list, cloud, N_RANDOM, 1e30);
+
+	l = alpha_shape_loops(a, 1e30);
+	if (l->n_loops != 1 || l->first[1] != (uint32_t)n_hull) {
+		printf("alpha shape of 1e30: %u loops, not the hull\n", l->n_loops);
+		failed++;
+	}
+	destroy_alpha_loops(l);
+	destroy_alpha_complex(a);
+	destroy_list(list);
+
+	return failed;
+}
+
+/* Builds in a bump arena, reset between them: the memory is handed out
+   again from its start, and the triangulations are the same as with
+   malloc() */
+static int check_arena(void)
+{
+	static point_t cloud[N_RANDOM];
+	arena_t *arena = create_arena(4096);
+	corner_table_t *ct;
+	tl_elt *list;
+	void *first;
+	int build, i, valid = 1, reused;
+
+	set_allocator(arena_allocator(arena));
+	first = mesh_alloc(64);
+	for (build=0; build < 3 && valid; build++) {
+		random_cloud(cloud, N_RANDOM, 100);
+		init_delaunay();
+		for (i=0; i < N_RANDOM; i++) insert_point(cloud+i);
+		ct = corner_table_from_quadedge(get_hull_edge(), cloud, N_RANDOM);
+		valid = (is_valid(ct) && is_delaunay(ct));
+		destroy_corner_table(ct);
+
+		if ((list = create_delaunay_triangulation(cloud, N_RANDOM)) == NULL) valid = 0;
+		else {
+			ct = corner_table_from_list(list, cloud, N_RANDOM);
+			valid = valid && is_valid(ct) && is_delaunay(ct);
+			destroy_corner_table(ct);
+			destroy_list(list);
+		}
+
+		collect_deleted_edges();
+		reset_arena(arena);
+		init_delaunay();
+	}
+	reused = (mesh_alloc(64) == first);
+	set_allocator(NULL);
+	destroy_arena(arena);
+
+	if (!valid) printf("arena, build %d: invalid triangulation\n", build);
+	if (!reused) printf("arena: memory not handed out again after a reset\n");
+	return (!valid || !reused);
+}
+
+/* A snapshot maps back to the same table, and a byte changed in its data
+   is caught by the checksum */
+static int check_snapshot(void)
+{
+	static point_t cloud[N_RANDOM];
+	corner_table_t *ct;
+	snapshot_t *s;
+	FILE *f;
+	int byte, same, corrupted = 0;
+
+	random_cloud(cloud, N_RANDOM, 100);
+	ct = create_sweephull_corner_table(cloud, N_RANDOM);
+	if (save_snapshot(ct, SNAPSHOT_PATH) != 0 || (s = open_snapshot(SNAPSHOT_PATH)) == NULL) {
+		printf("snapshot: unable to write or map %s\n", SNAPSHOT_PATH);
+		destroy_corner_table(ct);
+		return 1;
+	}
+	same = (verify_snapshot(s) && s->ct.n_vertices == ct->n_vertices &&
+	        s->ct.n_triangles == ct->n_triangles &&
+	        memcmp(s->ct.cloud, cloud, N_RANDOM * sizeof(point_t)) == 0 &&
+	        memcmp(s->ct.v, ct->v, 3 * ct->n_triangles * sizeof(uint32_t)) == 0 &&
+	        memcmp(s->ct.o, ct->o, 3 * ct->n_triangles * sizeof(uint32_t)) == 0);
+	close_snapshot(s);
+	destroy_corner_table(ct);
+
+	/* A bit of the last neighbor flipped */
+	if ((f = fopen(SNAPSHOT_PATH, "r+b")) != NULL) {
+		fseek(f, -1, SEEK_END);
+		byte = fgetc(f);
+		fseek(f, -1, SEEK_END);
+		fputc(byte ^ 1, f);
+		fclose(f);
+		if ((s = open_snapshot(SNAPSHOT_PATH)) != NULL) {
+			corrupted = !verify_snapshot(s);
+			close_snapshot(s);
+		}
+	}
+	remove(SNAPSHOT_PATH);
+
+	if (!same) printf("snapshot: not the table saved\n");
+	if (!corrupted) printf("snapshot: corrupted data not detected\n");
+	return (!same || !corrupted);
+}
+
+/* Triangulation of the points used so far: Delaunay, and a triangulation
+   of them (2k - 2 - h triangles for k vertices, h on the hull) */
+static int is_partial_delaunay(corner_table_t *ct)
+{
+	static unsigned char used[N_RANDOM];
+	uint32_t c, k = 0, hull = 0;
+
+	memset(used, 0, sizeof(used));
+	for (c=0; c < 3*ct->n_triangles; c++) {
+		if (!used[ct->v[c]]) k++;
+		used[ct->v[c]] = 1;
+		if (ct->o[c] == NO_CORNER) hull++;
+	}
+	return (ct->n_triangles == 2*k - 2 - hull && is_delaunay(ct));
+}
+
+/* A build in slices is Delaunay after every slice, and ends as the build
+   in one go */
+static int check_slices(void)
+{
+	static point_t cloud[N_RANDOM];
+	delaunay_build_t *b;
+	corner_table_t *ct, *whole;
+	tl_elt *list;
+	int left, last = N_RANDOM, valid = 1;
+
+	random_cloud(cloud, N_RANDOM, 100);
+	list = create_delaunay_triangulation(cloud, N_RANDOM);
+	whole = corner_table_from_list(list, cloud, N_RANDOM);
+	destroy_list(list);
+
+	b = start_delaunay_build(cloud, N_RANDOM);
+	do {
+		left = continue_delaunay_build(b, 17, 0);
+		ct = corner_table_from_list(get_build_triangulation(b), cloud, N_RANDOM);
+		valid = (left < last && is_partial_delaunay(ct));
+		destroy_corner_table(ct);
+		last = left;
+	} while (left > 0 && valid);
+
+	list = finish_delaunay_build(b);
+	ct = corner_table_from_list(list, cloud, N_RANDOM);
+	valid = valid && is_valid(ct) && is_delaunay(ct) && ct->n_triangles == whole->n_triangles;
+	destroy_corner_table(ct);
+	destroy_corner_table(whole);
+	destroy_list(list);
+
+	if (!valid) printf("build in slices, %d points left: invalid triangulation\n", left);
+	return !valid;
+}
+
+/* Part t_in..t_out of segment a->b in triangle t (Cyrus-Beck), empty if
+   t_in >= t_out. Returns 1 if the segment runs along an edge of t: the
+   traversal may then go through either of the triangles of the edge */
+static int clip_triangle(corner_table_t *ct, uint32_t t, point_t *a, point_t *b,
+                         double *t_in, double *t_out)
+{
+	point_t *u, *w;
+	double num, den;
+	int k, along = 0;
+
+	*t_in = 0;
+	*t_out = 1;
+	for (k=0; k < 3; k++) {
+		u = ct->cloud + ct->v[3*t+k];
+		w = ct->cloud + ct->v[3*t+(k+1)%3];
+		num = (w->y - u->y) * (u->x - a->x) + (u->x - w->x) * (u->y - a->y);
+		den = (w->y - u->y) * (b->x - a->x) + (u->x - w->x) * (b->y - a->y);
+		if (den == 0) {
+			if (num < 0) *t_out = -1;
+			if (num == 0) along = 1;
+		}
+		else if (den > 0) {
+			if (num / den < *t_out) *t_out = num / den;
+		}
+		else if (num / den > *t_in) *t_in = num / den;
+	}
+	return along;
+}
+
+/* Crossings of random segments, in and out of the hull and from vertex to
+   vertex, are the triangles clipping keeps, in order, end to end, and from
+   where the segment enters the hull to where it leaves it */
+static int check_traversal(void)
+{
+	static point_t cloud[N_RANDOM], from[N_SEGMENTS], to[N_SEGMENTS];
+	corner_table_t *ct;
+	traversal_t *tr;
+	crossing_t *x;
+	double t_in, t_out, enter, leave;
+	uint32_t i, j, t, n_crossed, n_traversed;
+	int failed = 0, along;
+
+	random_cloud(cloud, N_RANDOM, 100);
+	ct = create_sweephull_corner_table(cloud, N_RANDOM);
+	for (i=0; i < N_SEGMENTS; i++) {
+		if (i % 4 == 0) {
+			from[i] = cloud[(i*7) % N_RANDOM];
+			to[i]   = cloud[(i*13 + 1) % N_RANDOM];
+		}
+		else {
+			random_cloud(from+i, 1, 140);
+			random_cloud(to+i, 1, 140);
+			from[i].x -= 20; from[i].y -= 20;
+			to[i].x -= 20; to[i].y -= 20;
+		}
+	}
+	tr = traverse_segments(ct, from, to, N_SEGMENTS, 4);
+
+	for (i=0; i < N_SEGMENTS && !failed; i++) {
+		for (j = tr->first[i], n_traversed = 0; j < tr->first[i+1]; j++) {
+			x = tr->crossing + j;
+			along = clip_triangle(ct, x->triangle, from+i, to+i, &t_in, &t_out);
+			if (!along && x->t_out - x->t_in > 1e-12) n_traversed++;
+			if (fabs(t_in - x->t_in) > 1e-9 || fabs(t_out - x->t_out) > 1e-9 ||
+			    (j > tr->first[i] && x->t_in != x[-1].t_out))
+				failed = 1;
+		}
+
+		enter = 1;
+		leave = 0;
+		for (t=0, n_crossed=0; t < ct->n_triangles; t++) {
+			along = clip_triangle(ct, t, from+i, to+i, &t_in, &t_out);
+			if (t_out - t_in <= 1e-12) continue;
+			if (!along) n_crossed++;
+			if (t_in < enter) enter = t_in;
+			if (t_out > leave) leave = t_out;
+		}
+		if (n_crossed != n_traversed)
+			failed = 1;
+		else if (n_crossed > 0 && (fabs(tr->crossing[tr->first[i]].t_in - enter) > 1e-9 ||
+		                           fabs(tr->crossing[tr->first[i+1]-1].t_out - leave) > 1e-9))
+			failed = 1;
+	}
+	destroy_traversal(tr);
+	destroy_corner_table(ct);
+
+	if (failed) printf("traversal, segment %u: not the triangles it crosses\n", i-1);
+	return failed;
+}
+
+/* Centroid of the Voronoi cell of cloud[i] in the square [0, size]^2: the
+   square clipped by the bisector with every other point */
+static point_t cell_centroid(point_t *cloud, int n, int i, double size)
+{
+	static point_t poly[2][N_LLOYD + 4];
+	point_t *p = cloud+i, *a, *b, c = { 0, 0 };
+	double nx, ny, h, da, db, s, area = 0, w;
+	int j, k, m = 4, m2, cur = 0;
+
+	poly[0][0].x = 0;    poly[0][0].y = 0;
+	poly[0][1].x = size; poly[0][1].y = 0;
+	poly[0][2].x = size; poly[0][2].y = size;
+	poly[0][3].x = 0;    poly[0][3].y = size;
+
+	for (j=0; j < n; j++) {
+		if (j == i) continue;
+		/* Closer to p than to cloud[j]: nx x + ny y <= h */
+		nx = cloud[j].x - p->x;
+		ny = cloud[j].y - p->y;
+		h  = (cloud[j].x*cloud[j].x + cloud[j].y*cloud[j].y - p->x*p->x - p->y*p->y) / 2;
+		for (k=0, m2=0; k < m; k++) {
+			a  = poly[cur] + k;
+			b  = poly[cur] + (k+1)%m;
+			da = nx*a->x + ny*a->y - h;
+			db = nx*b->x + ny*b->y - h;
+			if (da <= 0) poly[1-cur][m2++] = *a;
+			if ((da < 0 && db > 0) || (da > 0 && db < 0)) {
+				s = da / (da - db);
+				poly[1-cur][m2].x = a->x + s * (b->x - a->x);
+				poly[1-cur][m2].y = a->y + s * (b->y - a->y);
+				m2++;
+			}
+		}
+		m = m2;
+		cur = 1-cur;
+	}
+
+	for (k=0; k < m; k++) {
+		a = poly[cur] + k;
+		b = poly[cur] + (k+1)%m;
+		w = a->x * b->y - b->x * a->y;
+		area += w;
+		c.x += (a->x + b->x) * w;
+		c.y += (a->y + b->y) * w;
+	}
+	c.x /= 3*area;
+	c.y /= 3*area;
+	return c;
+}
+
+/* First iteration, from random points (long moves, some of them halved):
+   every point goes to the centroid of its cell (computed by brute force),
+   or toward it by a halved move, or stays. The largest distance to a
+   centroid is returned, and the points stay in the domain, triangulated */
+static int check_lloyd(void)
+{
+	static point_t cloud[N_LLOYD], before[N_LLOYD];
+	point_t domain[4] = { { 0, 0 }, { 100, 0 }, { 100, 100 }, { 0, 100 } }, c;
+	corner_table_t *ct;
+	lloyd_t *l;
+	double max_move, largest = 0, d, f;
+	int i, k, failed = 0;
+
+	random_cloud(cloud, N_LLOYD, 100);
+	l = init_lloyd(cloud, N_LLOYD, domain, 4, 4);
+	memcpy(before, cloud, sizeof(before));
+	max_move = lloyd_iteration(l);
+
+	for (i=0; i < N_LLOYD && !failed; i++) {
+		c = cell_centroid(before, N_LLOYD, i, 100);
+		d = distance(before+i, &c);
+		if (d > largest) largest = d;
+		for (k=0, f=1; k <= 5; k++, f /= 2) {
+			if (k == 5) f = 0;
+			if (fabs(before[i].x + f*(c.x - before[i].x) - cloud[i].x) < 1e-7 &&
+			    fabs(before[i].y + f*(c.y - before[i].y) - cloud[i].y) < 1e-7)
+				break;
+		}
+		if (k > 5 || cloud[i].x < 0 || cloud[i].x > 100 || cloud[i].y < 0 || cloud[i].y > 100)
+			failed = 1;
+	}
+	if (failed) printf("lloyd, point %d: not moved toward the centroid of its cell\n", i-1);
+	else if (fabs(largest - max_move) > 1e-7) {
+		printf("lloyd: largest move %.12f, not %.12f\n", max_move, largest);
+		failed = 1;
+	}
+	else {
+		ct = lloyd_triangulation(l);
+		failed = (ct == NULL || !is_valid(ct) || !is_delaunay(ct));
+		destroy_corner_table(ct);
+		if (failed) printf("lloyd: invalid triangulation\n");
+	}
+	destroy_lloyd(l);
+
+	return failed;
+}
+
+int main(void)
+{
+	int k, failed = 0;
+	engine_id_t engine;
+
+	for (engine = QUADEDGE; engine <= LIST; engine++)
+		for (k=0; k <= 12; k++)
+			failed += check_grid(engine, 7.5*k);
+	for (k=0; k <= 12; k++)
+		failed += check_cancel(7.5*k);
+	failed += check_kinetic();
+	failed += check_knn();
+	failed += check_proximity();
+	failed += check_alpha();
+	failed += check_arena();
+	failed += check_snapshot();
+	failed += check_slices();
+	failed += check_traversal();
+	failed += check_lloyd();
+
+	printf("%s\n", failed ? "FAILED" : "ok");
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,175 @@
+/*
+    Locality renumbering of a corner table
+
+    Points are mapped to a 2^16 x 2^16 grid over their bounding box and
+    sorted by their distance along the Hilbert curve of that grid, which
+    keeps neighbors close in memory. Triangles are sorted by the key of
+    their centroid, so that a walk from triangle to triangle also stays in
+    nearby memory. Adjacency is rewritten with the new indices.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "global.h"
+#include "delaunay.h"
+#include "quadedge.h"
+#include "ctable.h"
+#include "renumber.h"
+
+#define HILBERT_BITS 16
+
+typedef struct {
+	uint32_t key;
+	uint32_t i;
+} sorted_item_t;
+
+typedef struct {
+	double x0, y0;
+	double scale;
+} hilbert_grid_t;
+
+static void *renumber_alloc(size_t size)
+{
+	void *p;
+
+	if ((p = malloc(size ? size : 1)) == NULL) {
+		fprintf(stderr, "Unable to allocate renumbering\n");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+static int compare_keys(const void *a, const void *b)
+{
+	uint32_t ka = ((sorted_item_t *)a)->key, kb = ((sorted_item_t *)b)->key;
+
+	if (ka != kb) return (ka < kb) ? -1 : 1;
+	return (((sorted_item_t *)a)->i < ((sorted_item_t *)b)->i) ? -1 : 1;
+}
+
+/* Distance of cell (x, y) along the Hilbert curve */
+static uint32_t hilbert_index(uint32_t x, uint32_t y)
+{
+	uint32_t d = 0, s, rx, ry, t, max = (1u << HILBERT_BITS) - 1;
+
+	for (s = 1u << (HILBERT_BITS-1); s > 0; s >>= 1) {
+		rx = (x & s) != 0;
+		ry = (y & s) != 0;
+		d += s * s * ((3 * rx) ^ ry);
+		if (ry == 0) { /* Rotates the quadrant */
+			if (rx == 1) {
+				x = max - x;
+				y = max - y;
+			}
+			t = x; x = y; y = t;
+		}
+	}
+	return d;
+}
+
+static void init_grid(hilbert_grid_t *g, point_t *cloud, uint32_t n)
+{
+	double x1, y1, extent;
+	uint32_t i;
+
+	g->x0 = x1 = (n > 0) ? cloud[0].x : 0;
+	g->y0 = y1 = (n > 0) ? cloud[0].y : 0;
+	for (i=1; i < n; i++) {
+		if (cloud[i].x < g->x0) g->x0 = cloud[i].x;
+		if (cloud[i].x > x1) x1 = cloud[i].x;
+		if (cloud[i].y < g->y0) g->y0 = cloud[i].y;
+		if (cloud[i].y > y1) y1 = cloud[i].y;
+	}
+	extent = (x1 - g->x0 > y1 - g->y0) ? x1 - g->x0 : y1 - g->y0;
+	g->scale = (extent > 0) ? ((1u << HILBERT_BITS) - 1) / extent : 0;
+}
+
+static uint32_t hilbert_key(hilbert_grid_t *g, double x, double y)
+{
+	return hilbert_index((uint32_t)((x - g->x0) * g->scale), (uint32_t)((y - g->y0) * g->scale));
+}
+
+corner_table_t *renumber_corner_table(corner_table_t *ct, point_t *cloud, uint32_t *vertex_order,
+                                      uint32_t *triangle_order)
+{
+	uint32_t n_v = ct->n_vertices, n_t = ct->n_triangles, i, k, c, *new_vertex, *new_triangle;
+	sorted_item_t *items = (sorted_item_t *)renumber_alloc(((n_v > n_t) ? n_v : n_t) * sizeof(sorted_item_t));
+	corner_table_t *out = create_corner_table(cloud, n_v, n_t);
+	point_t *p;
+	hilbert_grid_t g;
+	double x, y;
+
+	init_grid(&g, ct->cloud, n_v);
+
+	/* Vertices */
+	for (i=0; i < n_v; i++) {
+		items[i].key = hilbert_key(&g, ct->cloud[i].x, ct->cloud[i].y);
+		items[i].i   = i;
+	}
+	qsort(items, n_v, sizeof(sorted_item_t), compare_keys);
+
+	new_vertex = (uint32_t *)renumber_alloc(n_v * sizeof(uint32_t));
+	for (i=0; i < n_v; i++) {
+		new_vertex[items[i].i] = i;
+		cloud[i] = ct->cloud[items[i].i];
+		if (vertex_order != NULL) vertex_order[i] = items[i].i;
+	}
+
+	/* Triangles, by their centroid */
+	for (i=0; i < n_t; i++) {
+		for (k=0, x=0, y=0; k < 3; k++) {
+			p = ct->cloud + ct->v[3*i+k];
+			x += p->x;
+			y += p->y;
+		}
+		items[i].key = hilbert_key(&g, x/3, y/3);
+		items[i].i   = i;
+	}
+	qsort(items, n_t, sizeof(sorted_item_t), compare_keys);
+
+	new_triangle = (uint32_t *)renumber_alloc(n_t * sizeof(uint32_t));
+	for (i=0; i < n_t; i++) {
+		new_triangle[items[i].i] = i;
+		if (triangle_order != NULL) triangle_order[i] = items[i].i;
+	}
+
+	for (i=0; i < n_t; i++) {
+		for (k=0; k < 3; k++) {
+			c = ct->o[3*items[i].i + k];
+			out->v[3*i+k] = new_vertex[ct->v[3*items[i].i + k]];
+			out->o[3*i+k] = (c == NO_CORNER) ? NO_CORNER : 3*new_triangle[c/3] + c%3;
+		}
+	}
+
+	free(items);
+	free(new_vertex);
+	free(new_triangle);
+	return out;
+}
+
+void hilbert_order(point_t *p, uint32_t n, uint32_t *order)
+{
+	sorted_item_t *items = (sorted_item_t *)renumber_alloc(n * sizeof(sorted_item_t));
+	hilbert_grid_t g;
+	uint32_t i;
+
+	init_grid(&g, p, n);
+	for (i=0; i < n; i++) {
+		items[i].key = hilbert_key(&g, p[i].x, p[i].y);
+		items[i].i   = i;
+	}
+	qsort(items, n, sizeof(sorted_item_t), compare_keys);
+	for (i=0; i < n; i++) order[i] = items[i].i;
+
+	free(items);
+}
+
+void permute_values(double *value, uint32_t *order, uint32_t n)
+{
+	double *copy = (double *)renumber_alloc(n * sizeof(double));
+	uint32_t i;
+
+	memcpy(copy, value, n * sizeof(double));
+	for (i=0; i < n; i++) value[i] = copy[order[i]];
+	free(copy);
+}
@@ -0,0 +1,15 @@
+/* Copy of ct with its vertices and triangles renumbered along a Hilbert
+   curve, so that passes over the mesh read memory almost in order. ct is
+   only read (it may be mapped from a snapshot). The points are copied in
+   their new order to cloud (ct->n_vertices of them, not ct->cloud), which
+   the new table indexes. If not NULL, vertex_order[i] and
+   triangle_order[i] get the former index of the new vertex and triangle i
+   (see permute_values() for per-vertex values) */
+corner_table_t *renumber_corner_table(corner_table_t *ct, point_t *cloud, uint32_t *vertex_order,
+                                      uint32_t *triangle_order);
+
+/* Indices of the n points of p along a Hilbert curve over them */
+void hilbert_order(point_t *p, uint32_t n, uint32_t *order);
+
+/* Reorders value[] like the vertices: value[i] = former value[order[i]] */
+void permute_values(double *value, uint32_t *order, uint32_t n);
@@ -0,0 +1,318 @@
+/*
+    Triangulation of small point sets
+
+    The same ghost triangle scheme as the other engines (an infinite vertex
+    closes the hull), with Bowyer-Watson insertion: the triangles in
+    conflict with the new point, found from the triangle reached by a
+    visibility walk, are replaced by a fan around it. Capacities are fixed
+    at compile time, so everything lives in one structure on the stack, and
+    the predicates are local so that the compiler inlines them.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "global.h"
+#include "delaunay.h"
+#include "quadedge.h"
+#include "ctable.h"
+#include "small.h"
+
+#define INF SMALL_MAX_POINTS          /* Index of the infinite vertex */
+#define MAX_SLOTS SMALL_MAX_TRIANGLES /* Ghost triangles included */
+
+typedef struct {
+	point_t *cloud;
+	int v[MAX_SLOTS][3];     /* Direct order */
+	int t[MAX_SLOTS][3];     /* Neighbor opposite to v[][k] */
+	unsigned char alive[MAX_SLOTS];
+	unsigned char cavity[MAX_SLOTS];
+	int free_slot[MAX_SLOTS];
+	int n_free;
+	int n_slots;
+	int last;                /* Real triangle where walks start */
+	unsigned int coin;       /* State of the walk's random choices */
+	double orient_bound;     /* Static error bounds, see set_bounds() */
+	double circle_bound;
+} small_mesh_t;
+
+/* Steps after which the walk tries the edges in random order, then gives
+   up for a scan of the slots */
+#define WALK_GUARD MAX_SLOTS
+#define MAX_WALK (4 * MAX_SLOTS)
+
+/* Sign of the orientation of a, b, c. The error bound is static (see
+   set_bounds()): the rounded value is kept beyond it, the exact sign of
+   quadedge.c is taken within it */
+static inline double orient(small_mesh_t *m, point_t *a, point_t *b, point_t *c)
+{
+	double det = (b->x - a->x)*(c->y - a->y) - (b->y - a->y)*(c->x - a->x);
+
+	if (det >= m->orient_bound || -det >= m->orient_bound) return det;
+	return is_counter_clockwise(a, b, c) - is_counter_clockwise(b, a, c);
+}
+
+/* Same filter for the in-circle test, exact answer from incircle(). The
+   conflict zone is then exactly star-shaped around the new point */
+static inline int in_circle(small_mesh_t *m, point_t *a, point_t *b, point_t *c, point_t *d)
+{
+	double adx = a->x - d->x, ady = a->y - d->y;
+	double bdx = b->x - d->x, bdy = b->y - d->y;
+	double cdx = c->x - d->x, cdy = c->y - d->y;
+	double det = (adx*adx + ady*ady) * (bdx*cdy - cdx*bdy)
+	           + (bdx*bdx + bdy*bdy) * (cdx*ady - adx*cdy)
+	           + (cdx*cdx + cdy*cdy) * (adx*bdy - bdx*ady);
+
+	if (det >= m->circle_bound && det != 0) return 1;
+	if (-det >= m->circle_bound) return 0;
+	return incircle(a, b, c, d);
+}
+
+/* Error bounds of the two predicates over the whole cloud, from its extent
+   (every coordinate difference is below it): Shewchuk's relative bounds,
+   with their permanents bounded by 2 e^2 and 12 e^4, and some slack for
+   the rounding of e itself. If every coordinate is an integer below 2^10,
+   the determinants are computed exactly in doubles and the bounds are 0 */
+static void set_bounds(small_mesh_t *m, point_t *cloud, int n)
+{
+	double lo_x = cloud[0].x, hi_x = cloud[0].x, lo_y = cloud[0].y, hi_y = cloud[0].y, e;
+	int i, integer = 1;
+
+	for (i=0; i < n; i++) {
+		if (cloud[i].x < lo_x) lo_x = cloud[i].x;
+		if (cloud[i].x > hi_x) hi_x = cloud[i].x;
+		if (cloud[i].y < lo_y) lo_y = cloud[i].y;
+		if (cloud[i].y > hi_y) hi_y = cloud[i].y;
+		if (integer && !(fabs(cloud[i].x) < 1024 && fabs(cloud[i].y) < 1024 &&
+		                 cloud[i].x == (int)cloud[i].x && cloud[i].y == (int)cloud[i].y))
+			integer = 0;
+	}
+	if (integer) {
+		m->orient_bound = 0;
+		m->circle_bound = 0;
+		return;
+	}
+	e = (hi_x - lo_x > hi_y - lo_y) ? hi_x - lo_x : hi_y - lo_y;
+	m->orient_bound = 1e-15 * e*e;
+	m->circle_bound = 2e-14 * e*e*e*e;
+}
+
+static inline int is_ghost(small_mesh_t *m, int s)
+{
+	return (m->v[s][0] == INF || m->v[s][1] == INF || m->v[s][2] == INF);
+}
+
+static inline int in_conflict(small_mesh_t *m, int s, point_t *p)
+{
+	int *v = m->v[s], k;
+	point_t *a, *b;
+	double d;
+
+	for (k=0; k < 3 && v[k] != INF; k++);
+	if (k == 3) return in_circle(m, m->cloud + v[0], m->cloud + v[1], m->cloud + v[2], p);
+
+	/* Hull edge a->b, the outside on its left */
+	a = m->cloud + v[(k+1)%3];
+	b = m->cloud + v[(k+2)%3];
+	if ((d = orient(m, a, b, p)) != 0) return (d > 0);
+	return ((p->x - a->x)*(p->x - b->x) + (p->y - a->y)*(p->y - b->y) < 0);
+}
+
+static inline int new_slot(small_mesh_t *m)
+{
+	int s = (m->n_free > 0) ? m->free_slot[--m->n_free] : m->n_slots++;
+
+	m->alive[s]  = 1;
+	m->cavity[s] = 0;
+	return s;
+}
+
+static inline void set_triangle(small_mesh_t *m, int s, int a, int b, int c)
+{
+	m->v[s][0] = a;
+	m->v[s][1] = b;
+	m->v[s][2] = c;
+}
+
+/* First triangle (direct) and its three ghosts */
+static void start_mesh(small_mesh_t *m, int a, int b, int c)
+{
+	int g, k;
+
+	if (orient(m, m->cloud+a, m->cloud+b, m->cloud+c) < 0) { k = b; b = c; c = k; }
+
+	m->n_slots = 0;
+	m->n_free  = 0;
+	m->coin    = 12345;
+	m->last    = new_slot(m);
+	set_triangle(m, 0, a, b, c);
+	for (k=0; k < 3; k++) {
+		g = new_slot(m); /* 1 + k, across the edge facing v[0][k] */
+		set_triangle(m, g, m->v[0][(k+2)%3], m->v[0][(k+1)%3], INF);
+		m->t[0][k] = g;
+		m->t[g][2] = 0;
+	}
+	for (k=0; k < 3; k++) {
+		/* Ghost 1+k has the edge v2 -> v1 of triangle 0; its neighbors
+		   across its ends are the ghosts of the next and previous edges */
+		m->t[1+k][0] = 1 + (k+2)%3;
+		m->t[1+k][1] = 1 + (k+1)%3;
+	}
+}
+
+/* Edge k of triangle s has p strictly on its other side */
+static inline int is_behind(small_mesh_t *m, int s, int k, point_t *p)
+{
+	return orient(m, m->cloud + m->v[s][(k+1)%3], m->cloud + m->v[s][(k+2)%3], p) < 0;
+}
+
+static int scan(small_mesh_t *m, point_t *p)
+{
+	int s, k;
+
+	for (s=0; s < m->n_slots; s++) {
+		if (!m->alive[s]) continue;
+		if (is_ghost(m, s)) {
+			if (in_conflict(m, s, p)) return s;
+			continue;
+		}
+		for (k=0; k < 3 && !is_behind(m, s, k, p); k++);
+		if (k == 3) return s;
+	}
+	return m->last;
+}
+
+/* Triangle in conflict with p (the one containing it, or a ghost).
+   Remembering walk: the edge just crossed is not tested again. Past
+   WALK_GUARD steps the others are tried from a random one, so that it
+   cannot cycle on a triangulation that is not quite Delaunay */
+static inline int walk(small_mesh_t *m, point_t *p)
+{
+	int s = m->last, from = -1, steps, first, j, k;
+
+	for (steps=0; steps < MAX_WALK; steps++) {
+		if (is_ghost(m, s)) return s;
+
+		if (steps < WALK_GUARD) {
+			for (k=0; k < 3; k++)
+				if (m->t[s][k] != from && is_behind(m, s, k, p)) break;
+		}
+		else {
+			m->coin = m->coin * 1103515245u + 12345u;
+			first = (int)((m->coin >> 16) % 3);
+			for (j=0; j < 3; j++) {
+				k = (first + j) % 3;
+				if (m->t[s][k] != from && is_behind(m, s, k, p)) break;
+			}
+			if (j == 3) k = 3;
+		}
+		if (k == 3) return s;
+		from = s;
+		s = m->t[s][k];
+	}
+	return scan(m, p);
+}
+
+static void insert(small_mesh_t *m, int i)
+{
+	point_t *p = m->cloud + i;
+	int stack[MAX_SLOTS], cavity[MAX_SLOTS], n_stack = 0, n_cavity = 0;
+	int edge_a[MAX_SLOTS+2], edge_b[MAX_SLOTS+2], out[MAX_SLOTS+2], out_k[MAX_SLOTS+2], n_edges = 0;
+	int start_of[SMALL_MAX_POINTS+1], end_of[SMALL_MAX_POINTS+1];
+	int s, u, k, j, nt;
+
+	s = walk(m, p);
+	for (k=0; k < 3; k++) {
+		j = m->v[s][k];
+		if (j != INF && m->cloud[j].x == p->x && m->cloud[j].y == p->y) return; /* Duplicate */
+	}
+
+	/* Conflict zone, grown from s */
+	m->cavity[s] = 1;
+	stack[n_stack++] = cavity[n_cavity++] = s;
+	while (n_stack > 0) {
+		s = stack[--n_stack];
+		for (k=0; k < 3; k++) {
+			u = m->t[s][k];
+			if (m->cavity[u] || !in_conflict(m, u, p)) continue;
+			m->cavity[u] = 1;
+			stack[n_stack++] = cavity[n_cavity++] = u;
+		}
+	}
+
+	/* Its border, with the triangles outside */
+	for (j=0; j < n_cavity; j++) {
+		s = cavity[j];
+		for (k=0; k < 3; k++) {
+			u = m->t[s][k];
+			if (m->cavity[u]) continue;
+			edge_a[n_edges] = m->v[s][(k+1)%3];
+			edge_b[n_edges] = m->v[s][(k+2)%3];
+			out[n_edges] = u;
+			for (out_k[n_edges]=0; m->t[u][out_k[n_edges]] != s; out_k[n_edges]++);
+			n_edges++;
+		}
+	}
+	for (j=0; j < n_cavity; j++) {
+		m->alive[cavity[j]] = 0;
+		m->free_slot[m->n_free++] = cavity[j];
+	}
+
+	/* Fan around p */
+	for (j=0; j < n_edges; j++) {
+		nt = new_slot(m);
+		set_triangle(m, nt, edge_a[j], edge_b[j], i);
+		m->t[nt][2] = out[j];
+		m->t[out[j]][out_k[j]] = nt;
+		start_of[edge_a[j]] = nt;
+		end_of[edge_b[j]] = nt;
+		if (edge_a[j] != INF && edge_b[j] != INF) m->last = nt;
+	}
+	for (j=0; j < n_edges; j++) {
+		nt = m->t[out[j]][out_k[j]];
+		m->t[nt][0] = start_of[edge_b[j]]; /* Across b -> p */
+		m->t[nt][1] = end_of[edge_a[j]];   /* Across p -> a */
+	}
+}
+
+int small_triangulation(point_t *cloud, int n, uint32_t *v, uint32_t *o)
+{
+	small_mesh_t m;
+	int index[MAX_SLOTS], seed[3], s, k, j, u, n_t = 0;
+
+	if (n > SMALL_MAX_POINTS) return -1;
+	if (n < 3) return 0;
+
+	m.cloud = cloud;
+	set_bounds(&m, cloud, n);
+
+	/* First three non collinear points */
+	seed[0] = 0;
+	for (seed[1]=1; seed[1] < n; seed[1]++)
+		if (cloud[seed[1]].x != cloud[0].x || cloud[seed[1]].y != cloud[0].y) break;
+	for (seed[2]=seed[1]+1; seed[2] < n; seed[2]++)
+		if (orient(&m, cloud, cloud+seed[1], cloud+seed[2]) != 0) break;
+	if (seed[2] >= n) return 0;
+
+	start_mesh(&m, seed[0], seed[1], seed[2]);
+	for (j=1; j < n; j++)
+		if (j != seed[1] && j != seed[2]) insert(&m, j);
+
+	/* Real triangles, in slot order */
+	for (s=0; s < m.n_slots; s++)
+		index[s] = (m.alive[s] && !is_ghost(&m, s)) ? n_t++ : -1;
+
+	for (s=0; s < m.n_slots; s++) {
+		if (index[s] < 0) continue;
+		for (k=0; k < 3; k++) {
+			v[3*index[s]+k] = (uint32_t)m.v[s][k];
+			u = m.t[s][k];
+			if (index[u] < 0) {
+				o[3*index[s]+k] = NO_CORNER;
+				continue;
+			}
+			for (j=0; m.t[u][j] != s; j++);
+			o[3*index[s]+k] = 3*(uint32_t)index[u] + j;
+		}
+	}
+	return n_t;
+}
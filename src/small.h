@@ -0,0 +1,10 @@
+/* Delaunay triangulation of at most SMALL_MAX_POINTS points with no heap
+   allocation: the work arrays are on the stack */
+#define SMALL_MAX_POINTS 64
+#define SMALL_MAX_TRIANGLES (2*SMALL_MAX_POINTS)
+
+/* Writes the triangles as a corner table (ctable.h) indexing cloud: v and o
+   must hold 3*SMALL_MAX_TRIANGLES entries. Duplicate points are left out.
+   Returns the number of triangles, 0 if all the points are collinear, -1
+   if n > SMALL_MAX_POINTS */
+int small_triangulation(point_t *cloud, int n, uint32_t *v, uint32_t *o);
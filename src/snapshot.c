@@ -0,0 +1,204 @@
+/*
+    Binary snapshot of a corner table (ctable.c)
+
+    The corner table is already free of pointers: vertices and neighbors
+    are indices. The file is a fixed header followed by the points, v[]
+    and o[] arrays, in native byte order and aligned, so that mapping it is
+    enough to query it: no parsing, nothing allocated per element. The
+    header holds a magic string, the version, a byte order mark, the sizes
+    and a Fletcher-64 checksum of everything after it.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifndef __MINGW__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "global.h"
+#include "delaunay.h"
+#include "quadedge.h"
+#include "ctable.h"
+#include "snapshot.h"
+
+#define SNAPSHOT_MAGIC "DELAUNAY"
+#define BYTE_ORDER_MARK 0x01020304u
+
+typedef struct {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+	uint32_t n_vertices;
+	uint32_t n_triangles;
+	uint64_t checksum;
+} snapshot_header_t; /* 32 bytes: the points that follow are aligned */
+
+static size_t payload_size(uint32_t n_vertices, uint32_t n_triangles)
+{
+	return n_vertices * sizeof(point_t) + 2 * 3 * (size_t)n_triangles * sizeof(uint32_t);
+}
+
+/* Fletcher-64 over 32 bit words, carried across calls in sum */
+static void checksum_update(uint64_t sum[2], const void *data, size_t size)
+{
+	const uint32_t *w = (const uint32_t *)data;
+	uint64_t a = sum[0], b = sum[1];
+	size_t i, n = size / 4, k;
+
+	for (i=0; i < n; ) {
+		/* Small enough blocks for the sums not to overflow */
+		for (k = (n - i < 8192) ? n - i : 8192; k > 0; k--, i++) {
+			a += w[i];
+			b += a;
+		}
+		a %= 0xffffffffu;
+		b %= 0xffffffffu;
+	}
+	sum[0] = a;
+	sum[1] = b;
+}
+
+static int write_all(FILE *f, const void *data, size_t size, uint64_t sum[2])
+{
+	if (sum != NULL) checksum_update(sum, data, size);
+	return (size == 0 || fwrite(data, size, 1, f) == 1) ? 0 : -1;
+}
+
+int save_snapshot(corner_table_t *ct, const char *path)
+{
+	snapshot_header_t h;
+	uint64_t sum[2] = { 0, 0 };
+	size_t n_c = 3 * (size_t)ct->n_triangles;
+	FILE *f;
+	int err;
+
+	if ((f = fopen(path, "wb")) == NULL) return -1;
+
+	/* Checksum first: the header is written once */
+	checksum_update(sum, ct->cloud, ct->n_vertices * sizeof(point_t));
+	checksum_update(sum, ct->v, n_c * sizeof(uint32_t));
+	checksum_update(sum, ct->o, n_c * sizeof(uint32_t));
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, SNAPSHOT_MAGIC, sizeof(h.magic));
+	h.version     = SNAPSHOT_VERSION;
+	h.byte_order  = BYTE_ORDER_MARK;
+	h.n_vertices  = ct->n_vertices;
+	h.n_triangles = ct->n_triangles;
+	h.checksum    = (sum[1] << 32) | sum[0];
+
+	err = write_all(f, &h, sizeof(h), NULL) ||
+	      write_all(f, ct->cloud, ct->n_vertices * sizeof(point_t), NULL) ||
+	      write_all(f, ct->v, n_c * sizeof(uint32_t), NULL) ||
+	      write_all(f, ct->o, n_c * sizeof(uint32_t), NULL);
+
+	if (fclose(f) != 0) err = 1;
+	return err ? -1 : 0;
+}
+
+#ifdef __MINGW__
+/* No mmap: the file is read in one piece */
+static void *map_file(const char *path, size_t *size)
+{
+	FILE *f;
+	void *base;
+	long end;
+
+	if ((f = fopen(path, "rb")) == NULL) return NULL;
+	if (fseek(f, 0, SEEK_END) != 0 || (end = ftell(f)) < 0 || fseek(f, 0, SEEK_SET) != 0) {
+		fclose(f);
+		return NULL;
+	}
+	*size = (size_t)end;
+	if ((base = malloc(*size ? *size : 1)) == NULL) {
+		fprintf(stderr, "Unable to allocate snapshot\n");
+		exit(EXIT_FAILURE);
+	}
+	if (*size > 0 && fread(base, *size, 1, f) != 1) {
+		free(base);
+		base = NULL;
+	}
+	fclose(f);
+	return base;
+}
+
+static void unmap_file(void *base, size_t size)
+{
+	free(base);
+}
+#else
+static void *map_file(const char *path, size_t *size)
+{
+	struct stat st;
+	void *base;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0) return NULL;
+	if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(snapshot_header_t)) {
+		close(fd);
+		return NULL;
+	}
+	*size = (size_t)st.st_size;
+	base = mmap(NULL, *size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	return (base == MAP_FAILED) ? NULL : base;
+}
+
+static void unmap_file(void *base, size_t size)
+{
+	munmap(base, size);
+}
+#endif
+
+snapshot_t *open_snapshot(const char *path)
+{
+	snapshot_header_t *h;
+	snapshot_t *s;
+	size_t size = 0;
+	char *base;
+
+	if ((base = (char *)map_file(path, &size)) == NULL) return NULL;
+	h = (snapshot_header_t *)base;
+
+	if (size < sizeof(snapshot_header_t) || memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0 ||
+	    h->version != SNAPSHOT_VERSION || h->byte_order != BYTE_ORDER_MARK ||
+	    size != sizeof(snapshot_header_t) + payload_size(h->n_vertices, h->n_triangles)) {
+		unmap_file(base, size);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	if ((s = (snapshot_t *)malloc(sizeof(snapshot_t))) == NULL) {
+		fprintf(stderr, "Unable to allocate snapshot\n");
+		exit(EXIT_FAILURE);
+	}
+	s->base = base;
+	s->size = size;
+	s->ct.n_vertices  = h->n_vertices;
+	s->ct.n_triangles = h->n_triangles;
+	s->ct.cloud = (point_t *)(base + sizeof(snapshot_header_t));
+	s->ct.v     = (uint32_t *)(s->ct.cloud + h->n_vertices);
+	s->ct.o     = s->ct.v + 3 * (size_t)h->n_triangles;
+
+	return s;
+}
+
+int verify_snapshot(snapshot_t *s)
+{
+	snapshot_header_t *h = (snapshot_header_t *)s->base;
+	uint64_t sum[2] = { 0, 0 };
+
+	checksum_update(sum, (char *)s->base + sizeof(snapshot_header_t), s->size - sizeof(snapshot_header_t));
+	return (((sum[1] << 32) | sum[0]) == h->checksum);
+}
+
+void close_snapshot(snapshot_t *s)
+{
+	if (s == NULL) return;
+
+	unmap_file(s->base, s->size);
+	free(s);
+}
@@ -0,0 +1,22 @@
+/* Read-only triangulation mapped from a snapshot file. ct points into the
+   mapping: it can be given to any function reading a corner table, but
+   must not be modified nor destroyed */
+typedef struct {
+	corner_table_t ct;
+	void *base;
+	size_t size;
+} snapshot_t;
+
+#define SNAPSHOT_VERSION 1
+
+/* Writes ct and its points to path. Returns 0, or -1 with errno set */
+int save_snapshot(corner_table_t *ct, const char *path);
+
+/* Maps a snapshot: only the header and the size are checked, the data is
+   not read. Returns NULL if path is not a snapshot of this version */
+snapshot_t *open_snapshot(const char *path);
+
+/* Compares the checksum with the data (reads the whole snapshot) */
+int verify_snapshot(snapshot_t *s);
+
+void close_snapshot(snapshot_t *s);
@@ -0,0 +1,433 @@
+/*
+    Radial sweep-hull Delaunay triangulation
+
+    Points are sorted by their distance to the circumcenter of a seed
+    triangle. Each point is then outside of the current convex hull: it is
+    connected to every hull edge it sees (fan insertion). The resulting
+    triangulation is made Delaunay by a single flip pass driven by an
+    explicit stack of edges.
+
+    Triangles are built as half-edges: half-edge e goes from vertex v[e] to
+    vertex v[next(e)], triangle t owns half-edges 3t, 3t+1, 3t+2 and opp[e]
+    is the twin half-edge in the neighbor triangle (-1 on the hull).
+    The result is returned in the same form as create_delaunay_triangulation(),
+    or as a corner table (which is the same layout, shifted by one corner)
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "global.h"
+#include "util.h"
+#include "delaunay.h"
+#include "quadedge.h"
+#include "ctable.h"
+#include "sweephull.h"
+#include "alloc.h"
+
+#define NEXT(e) ((e) % 3 == 2 ? (e) - 2 : (e) + 1)
+#define PREV(e) ((e) % 3 == 0 ? (e) + 2 : (e) - 1)
+
+typedef struct {
+	double d;
+	int i;
+} sorted_point_t;
+
+typedef struct {
+	point_t *cloud;
+	int *v;          /* Origin vertex of each half-edge */
+	int *opp;        /* Twin half-edge, -1 on the hull */
+	int n_tri;
+	int *hull_next;
+	int *hull_prev;
+	int *hull_tri;   /* Half-edge along hull edge i -> hull_next[i] */
+	int *hash;
+	int hash_size;
+	point_t c;       /* Sweep center */
+} sweep_t;
+
+static void *sweep_alloc(size_t size)
+{
+	void *p;
+
+	if ((p = malloc(size)) == NULL) {
+		fprintf(stderr, "Unable to allocate sweep-hull buffers\n");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+static double dist2(point_t *a, point_t *b)
+{
+	return (a->x - b->x)*(a->x - b->x) + (a->y - b->y)*(a->y - b->y);
+}
+
+/* p is strictly outside of the direct hull edge a -> b. The orientation is
+   exact (quadedge.c): a point on the line of a hull edge, or so close to it
+   that the rounded product would pick a side at random, does not see it
+   and leaves it on the hull. The fan then never gets a triangle of zero
+   or negative area */
+static int is_visible(point_t *p, point_t *a, point_t *b)
+{
+	return is_counter_clockwise(b, a, p);
+}
+
+/* d strictly inside the circumcircle of the direct triangle (a, b, c), and
+   by more than the rounding error of the determinant (Shewchuk's bound):
+   nearly cocircular points are a tie, and do not flip. Every flip then
+   lowers the lifted surface in exact arithmetic, so that legalize() ends,
+   and a flipped edge is never flipped back */
+static int in_circle(point_t *a, point_t *b, point_t *c, point_t *d)
+{
+	double adx = a->x - d->x, ady = a->y - d->y;
+	double bdx = b->x - d->x, bdy = b->y - d->y;
+	double cdx = c->x - d->x, cdy = c->y - d->y;
+	double ad = adx*adx + ady*ady, bd = bdx*bdx + bdy*bdy, cd = cdx*cdx + cdy*cdy;
+	double det, bound;
+
+	det = ad*(bdx*cdy - cdx*bdy) + bd*(cdx*ady - adx*cdy) + cd*(adx*bdy - bdx*ady);
+	bound = (fabs(bdx*cdy) + fabs(cdx*bdy)) * ad
+	      + (fabs(cdx*ady) + fabs(adx*cdy)) * bd
+	      + (fabs(adx*bdy) + fabs(bdx*ady)) * cd;
+
+	return (det > 1.1102230246251577e-15 * bound);
+}
+
+static double circumradius2(point_t *a, point_t *b, point_t *c)
+{
+	triangle_t t;
+
+	t.p[0] = a; t.p[1] = b; t.p[2] = c;
+	set_circumcircle(&t);
+	return t.r * t.r;
+}
+
+static int compare_distance(const void *a, const void *b)
+{
+	double d = ((sorted_point_t *)a)->d - ((sorted_point_t *)b)->d;
+
+	if (d < 0) return -1;
+	if (d > 0) return 1;
+	return 0;
+}
+
+/* Monotonic in the angle of (dx, dy), in [0, 1[ */
+static int hash_key(sweep_t *s, point_t *p)
+{
+	double dx = p->x - s->c.x, dy = p->y - s->c.y;
+	double q = dx / (fabs(dx) + fabs(dy));
+	double a = (dy > 0 ? 3 - q : 1 + q) / 4;
+
+	return ((int)floor(a * s->hash_size)) % s->hash_size;
+}
+
+static void link_edges(sweep_t *s, int a, int b)
+{
+	s->opp[a] = b;
+	if (b != -1) s->opp[b] = a;
+}
+
+static int add_sweep_triangle(sweep_t *s, int i0, int i1, int i2, int a, int b, int c)
+{
+	int e = 3 * s->n_tri++;
+
+	s->v[e] = i0; s->v[e+1] = i1; s->v[e+2] = i2;
+	link_edges(s, e, a);
+	link_edges(s, e+1, b);
+	link_edges(s, e+2, c);
+
+	return e;
+}
+
+/* Seed triangle: point closest to the center of the cloud, its nearest
+   neighbor, and the point giving the smallest circumcircle with them */
+static int find_seed(point_t *cloud, int n, int seed[3])
+{
+	point_t lo = cloud[0], hi = cloud[0], c;
+	double d, d_min;
+	int i, tmp;
+
+	for (i=1; i < n; i++) {
+		if (cloud[i].x < lo.x) lo.x = cloud[i].x;
+		if (cloud[i].y < lo.y) lo.y = cloud[i].y;
+		if (cloud[i].x > hi.x) hi.x = cloud[i].x;
+		if (cloud[i].y > hi.y) hi.y = cloud[i].y;
+	}
+	c.x = (lo.x + hi.x) / 2;
+	c.y = (lo.y + hi.y) / 2;
+
+	seed[0] = 0; d_min = -1;
+	for (i=0; i < n; i++) {
+		d = dist2(&c, cloud+i);
+		if (d_min < 0 || d < d_min) { seed[0] = i; d_min = d; }
+	}
+
+	seed[1] = -1; d_min = -1;
+	for (i=0; i < n; i++) {
+		d = dist2(cloud+seed[0], cloud+i);
+		if (d > 0 && (d_min < 0 || d < d_min)) { seed[1] = i; d_min = d; }
+	}
+	if (seed[1] < 0) return 0;
+
+	seed[2] = -1; d_min = -1;
+	for (i=0; i < n; i++) {
+		if (!is_counter_clockwise(cloud+seed[0], cloud+seed[1], cloud+i) &&
+		    !is_counter_clockwise(cloud+seed[1], cloud+seed[0], cloud+i)) continue;
+		d = circumradius2(cloud+seed[0], cloud+seed[1], cloud+i);
+		if (d_min < 0 || d < d_min) { seed[2] = i; d_min = d; }
+	}
+	if (seed[2] < 0) return 0;
+
+	if (!is_counter_clockwise(cloud+seed[0], cloud+seed[1], cloud+seed[2])) {
+		tmp = seed[1]; seed[1] = seed[2]; seed[2] = tmp;
+	}
+	return 1;
+}
+
+static void add_to_hull(sweep_t *s, int i, int start, int e)
+{
+	point_t *p = s->cloud + i;
+	int n, q, t;
+
+	/* Fan over the visible hull edges, first e -> hull_next[e]... */
+	t = add_sweep_triangle(s, e, i, s->hull_next[e], -1, -1, s->hull_tri[e]);
+	s->hull_tri[i] = t + 1;
+	s->hull_tri[e] = t;
+
+	/* ...then forward... */
+	n = s->hull_next[e];
+	while (q = s->hull_next[n], is_visible(p, s->cloud+n, s->cloud+q)) {
+		t = add_sweep_triangle(s, n, i, q, s->hull_tri[i], -1, s->hull_tri[n]);
+		s->hull_tri[i] = t + 1;
+		s->hull_next[n] = n; /* Not on the hull anymore */
+		n = q;
+	}
+
+	/* ...and backward */
+	if (e == start) {
+		while (q = s->hull_prev[e], is_visible(p, s->cloud+q, s->cloud+e)) {
+			t = add_sweep_triangle(s, q, i, e, -1, s->hull_tri[e], s->hull_tri[q]);
+			s->hull_tri[q] = t;
+			s->hull_next[e] = e;
+			e = q;
+		}
+	}
+
+	s->hull_prev[i] = e; s->hull_next[e] = i;
+	s->hull_prev[n] = i; s->hull_next[i] = n;
+
+	s->hash[hash_key(s, p)] = i;
+	s->hash[hash_key(s, s->cloud+e)] = e;
+}
+
+/* Finds a hull edge visible from p, -1 if there is none */
+static int find_visible_edge(sweep_t *s, point_t *p, int *start)
+{
+	int key = hash_key(s, p), j, e;
+
+	*start = -1;
+	for (j=0; j < s->hash_size; j++) {
+		*start = s->hash[(key + j) % s->hash_size];
+		if (*start != -1 && *start != s->hull_next[*start]) break;
+	}
+
+	*start = s->hull_prev[*start];
+	e = *start;
+	while (!is_visible(p, s->cloud+e, s->cloud+s->hull_next[e])) {
+		e = s->hull_next[e];
+		if (e == *start) return -1;
+	}
+	return e;
+}
+
+/* Lawson flips until every edge is locally Delaunay */
+static void legalize(sweep_t *s)
+{
+	int *stack, *queued, top = 0, e, i;
+
+	stack  = (int *)sweep_alloc(3 * s->n_tri * sizeof(int));
+	queued = (int *)sweep_alloc(3 * s->n_tri * sizeof(int));
+
+	for (e=0; e < 3 * s->n_tri; e++) {
+		queued[e] = (s->opp[e] > e);
+		if (queued[e]) stack[top++] = e;
+	}
+
+	while (top > 0) {
+		int a = stack[--top], b = s->opp[a];
+		int al, ar, bl, br, p0, pr, pl, p1, flipped[4];
+
+		queued[a] = 0;
+		if (b == -1) continue;
+
+		al = NEXT(a); ar = PREV(a);
+		bl = PREV(b); br = NEXT(b);
+		p0 = s->v[ar]; pr = s->v[a]; pl = s->v[al]; p1 = s->v[bl];
+
+		if (!in_circle(s->cloud+p0, s->cloud+pr, s->cloud+pl, s->cloud+p1))
+			continue;
+
+		/* Both new triangles must keep a positive area */
+		if (!is_counter_clockwise(s->cloud+p0, s->cloud+pr, s->cloud+p1) ||
+		    !is_counter_clockwise(s->cloud+p1, s->cloud+pl, s->cloud+p0))
+			continue;
+
+		/* Flip a/b into ar/bl */
+		s->v[a] = p1;
+		s->v[b] = p0;
+		link_edges(s, a, s->opp[bl]);
+		link_edges(s, b, s->opp[ar]);
+		link_edges(s, ar, bl);
+
+		flipped[0] = a; flipped[1] = al; flipped[2] = b; flipped[3] = br;
+		for (i=0; i < 4; i++) {
+			e = flipped[i];
+			if (s->opp[e] == -1) continue;
+			if (s->opp[e] < e) e = s->opp[e];
+			if (!queued[e]) {
+				queued[e] = 1;
+				stack[top++] = e;
+			}
+		}
+	}
+
+	free(stack);
+	free(queued);
+}
+
+static tl_elt *to_triangle_list(sweep_t *s)
+{
+	triangle_t **tri;
+	tl_elt *list = NULL;
+	int t, k, e;
+
+	tri = (triangle_t **)sweep_alloc(s->n_tri * sizeof(triangle_t *));
+	for (t=0; t < s->n_tri; t++) {
+		if ((tri[t] = (triangle_t *)mesh_alloc(sizeof(triangle_t))) == NULL) {
+			fprintf(stderr, "Unable to allocate triangle\n");
+			exit(EXIT_FAILURE);
+		}
+		for (k=0; k < 3; k++)
+			tri[t]->p[k] = s->cloud + s->v[3*t+k];
+		set_circumcircle(tri[t]);
+	}
+
+	/* t[k] is the neighbor opposite to p[k], across half-edge 3t+k+1 */
+	for (t=0; t < s->n_tri; t++) {
+		for (k=0; k < 3; k++) {
+			e = s->opp[3*t + (k+1)%3];
+			tri[t]->t[k] = (e == -1) ? NULL : tri[e/3];
+		}
+		list = add_triangle(list, tri[t]);
+	}
+
+	free(tri);
+	return list;
+}
+
+/* Builds the triangulation in s. Returns 0 if all the points are collinear */
+static int sweep(sweep_t *s, point_t *cloud, int n)
+{
+	sorted_point_t *order;
+	int seed[3], i, k, e, start, max_tri;
+	point_t *p, *last = NULL;
+
+	if (n < 3 || !find_seed(cloud, n, seed)) return 0;
+
+	max_tri = 2*n - 5 > 1 ? 2*n - 5 : 1;
+	s->cloud     = cloud;
+	s->v         = (int *)sweep_alloc(3 * max_tri * sizeof(int));
+	s->opp       = (int *)sweep_alloc(3 * max_tri * sizeof(int));
+	s->hull_next = (int *)sweep_alloc(n * sizeof(int));
+	s->hull_prev = (int *)sweep_alloc(n * sizeof(int));
+	s->hull_tri  = (int *)sweep_alloc(n * sizeof(int));
+	s->hash_size = (int)ceil(sqrt(n));
+	s->hash      = (int *)sweep_alloc(s->hash_size * sizeof(int));
+	s->n_tri     = 0;
+	for (i=0; i < s->hash_size; i++) s->hash[i] = -1;
+
+	/* Seed triangle */
+	{
+		triangle_t t;
+		t.p[0] = cloud+seed[0]; t.p[1] = cloud+seed[1]; t.p[2] = cloud+seed[2];
+		set_circumcircle(&t);
+		s->c = t.o;
+	}
+	add_sweep_triangle(s, seed[0], seed[1], seed[2], -1, -1, -1);
+	for (k=0; k < 3; k++) {
+		s->hull_next[seed[k]] = seed[(k+1)%3];
+		s->hull_prev[seed[k]] = seed[(k+2)%3];
+		s->hull_tri[seed[k]]  = k;
+		s->hash[hash_key(s, cloud+seed[k])] = seed[k];
+	}
+
+	/* Sweep */
+	order = (sorted_point_t *)sweep_alloc(n * sizeof(sorted_point_t));
+	for (i=0; i < n; i++) {
+		order[i].d = dist2(&s->c, cloud+i);
+		order[i].i = i;
+	}
+	qsort(order, n, sizeof(sorted_point_t), compare_distance);
+
+	for (i=0; i < n; i++) {
+		k = order[i].i;
+		p = cloud + k;
+
+		if (k == seed[0] || k == seed[1] || k == seed[2]) continue;
+		if (last != NULL && p->x == last->x && p->y == last->y) continue; /* Duplicate */
+		last = p;
+
+		if ((e = find_visible_edge(s, p, &start)) == -1) continue; /* Duplicate of a hull point */
+		add_to_hull(s, k, start, e);
+	}
+	free(order);
+	free(s->hull_next); free(s->hull_prev); free(s->hull_tri);
+	free(s->hash);
+
+	legalize(s);
+	return 1;
+}
+
+tl_elt *create_sweephull_triangulation(point_t *cloud, int n)
+{
+	sweep_t s;
+	tl_elt *list;
+
+	if (!sweep(&s, cloud, n)) return NULL;
+
+	list = to_triangle_list(&s);
+	free(s.v);
+	free(s.opp);
+	return list;
+}
+
+corner_table_t *create_sweephull_corner_table(point_t *cloud, int n)
+{
+	corner_table_t *ct;
+	sweep_t s;
+	int t, k, h[3];
+
+	if (!sweep(&s, cloud, n)) return NULL;
+
+	/* The corner facing half-edge e is PREV(e): rewrite opp in place */
+	for (t=0; t < s.n_tri; t++) {
+		for (k=0; k < 3; k++) h[k] = s.opp[3*t + (k+1)%3];
+		for (k=0; k < 3; k++) s.opp[3*t+k] = (h[k] == -1) ? -1 : PREV(h[k]);
+	}
+
+	/* Hand the buffers over: int and uint32_t have the same size */
+	if ((ct = (corner_table_t *)malloc(sizeof(corner_table_t))) == NULL) {
+		fprintf(stderr, "Unable to allocate corner table\n");
+		exit(EXIT_FAILURE);
+	}
+	ct->cloud       = cloud;
+	ct->n_vertices  = n;
+	ct->n_triangles = s.n_tri;
+	ct->v = (uint32_t *)realloc(s.v, 3 * s.n_tri * sizeof(uint32_t));
+	ct->o = (uint32_t *)realloc(s.opp, 3 * s.n_tri * sizeof(uint32_t));
+	if (ct->v == NULL || ct->o == NULL) {
+		fprintf(stderr, "Unable to allocate corner table\n");
+		exit(EXIT_FAILURE);
+	}
+
+	return ct;
+}
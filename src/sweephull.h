@@ -0,0 +1,7 @@
+/* Delaunay triangulation of cloud by radial sweep-hull. Same output as
+   create_delaunay_triangulation(). Duplicate points are skipped. Returns
+   NULL if all points are collinear */
+tl_elt *create_sweephull_triangulation(point_t *cloud, int n);
+
+/* Same, built directly as a corner table (no triangle_t allocated) */
+corner_table_t *create_sweephull_corner_table(point_t *cloud, int n);
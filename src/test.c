@@ -24,12 +24,14 @@
 #include "global.h"
 #include "util.h"
 #include "delaunay.h"
+#include "dedup.h"
 #include "SDL/SDL.h"
 #include "SDL/SDL_image.h"
 #include "SDL/SDL_gfxPrimitives.h"
 
 #define SCREEN_W 640
 #define SCREEN_H 480
+#define SLICE_SECONDS 0.02
 
 const char *WINDOW_TITLE = "Geometry";
 
@@ -51,46 +53,41 @@ void display_triangle(triangle_t *t, SDL_Surface *screen)
 	}
 }
 
-int is_duplicate (point_t *cloud, int n)
+void display_triangulation(tl_elt *triangulation, SDL_Surface *screen)
 {
-	int i;
-	
-	for (i=0; i < n; i++)
-	{
-		if ((cloud[i].x == cloud[n].x) && (cloud[i].y == cloud[n].y))
-			return 1;
-	}
-	return 0;
+	tl_elt *tmp;
+
+    SDL_FillRect (SDL_GetVideoSurface (), NULL, 0);
+	for (tmp = triangulation; tmp != NULL; tmp = tmp->n)
+		display_triangle(tmp->t, screen);
 }
 
 void test_delaunay(SDL_Surface *screen, int n)
 {
  	point_t *cloud;
-	tl_elt *triangulation, *tmp;
+	tl_elt *triangulation;
+	delaunay_build_t *build;
 	int i;
 
-    SDL_FillRect (SDL_GetVideoSurface (), NULL, 0);
-
 	if ( (cloud = (point_t*)malloc(n*sizeof(point_t))) == NULL) {
 		fprintf(stderr, "Unable to get memory for point cloud.\n");
 		exit(EXIT_FAILURE);
 	}
 
 	for (i=0; i<n; i++) {
-		do {
-			cloud[i].x = 10 + rand()%(screen->w-11);
-			cloud[i].y = 10 + rand()%(screen->h-11);
-		}
-		while (is_duplicate(cloud, i));
+		cloud[i].x = 10 + rand()%(screen->w-11);
+		cloud[i].y = 10 + rand()%(screen->h-11);
 	}
+	n = remove_duplicates(cloud, n, 0, cloud, NULL);
 
-	triangulation = create_delaunay_triangulation(cloud, n, screen->w, screen->h);
-	tmp = triangulation;
-	while(tmp != NULL)
-	{
-		display_triangle(tmp->t, screen);
-		tmp = tmp->n;
+	/* Large clouds are shown while they are built */
+	build = start_delaunay_build(cloud, n);
+	while (continue_delaunay_build(build, 0, SLICE_SECONDS) > 0) {
+		display_triangulation(get_build_triangulation(build), screen);
+		SDL_Flip (screen);
 	}
+	triangulation = finish_delaunay_build(build);
+	display_triangulation(triangulation, screen);
 	
 	for (i=0; i<n; i++) {
 		circleRGBA(screen, cloud[i].x, cloud[i].y, 1, 255, 0, 0, SDL_ALPHA_OPAQUE);
@@ -0,0 +1,361 @@
+/*
+    Segment traversal through a triangulation
+
+    The start of the segment is located by a visibility walk from the last
+    segment of the same worker, the segments being taken along a Hilbert
+    curve through their starts so that the walks are short. Then, in each triangle, the segment is
+    clipped against the three edge lines (Cyrus-Beck): it leaves through
+    the edge it crosses first going outwards, and goes on in the neighbor
+    across that edge, until it ends or leaves the hull (which it cannot
+    enter again: the hull is convex). Where the segment goes through a
+    vertex, the next triangle is found by turning around the vertex to the
+    one whose angle holds the direction of the segment. A segment starting
+    outside of the hull is clipped against the hull edges to find its first
+    triangle.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "global.h"
+#include "delaunay.h"
+#include "quadedge.h"
+#include "ctable.h"
+#include "renumber.h"
+#include "traverse.h"
+
+#define CHUNK 64 /* Segments taken at once by a worker */
+
+typedef struct {
+	corner_table_t *ct;
+	point_t *from;
+	point_t *to;
+	uint32_t n;
+	uint32_t *order;        /* Segments in the order they are taken */
+	uint32_t *border;       /* Corners facing the hull edges */
+	uint32_t n_border;
+	uint32_t *count;        /* Crossings of each segment */
+	uint32_t *worker;       /* Worker of each segment */
+	uint32_t *offset;       /* First crossing of each segment in its worker buffer */
+	volatile int next;
+} traverse_batch_t;
+
+typedef struct {
+	traverse_batch_t *b;
+	int id;
+	uint32_t last;          /* Start of the next walk */
+	crossing_t *crossing;
+	uint32_t n_crossing;
+	uint32_t max_crossing;
+} traverse_worker_t;
+
+static void *traverse_alloc(size_t size)
+{
+	void *p;
+
+	if ((p = malloc(size ? size : 1)) == NULL) {
+		fprintf(stderr, "Unable to allocate segment traversal\n");
+		exit(EXIT_FAILURE);
+	}
+	return p;
+}
+
+static void add_crossing(traverse_worker_t *w, uint32_t t, double t_in, double t_out)
+{
+	if (w->n_crossing == w->max_crossing) {
+		w->max_crossing = w->max_crossing ? 2*w->max_crossing : 1024;
+		if ((w->crossing = (crossing_t *)realloc(w->crossing, w->max_crossing * sizeof(crossing_t))) == NULL) {
+			fprintf(stderr, "Unable to allocate segment traversal\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	w->crossing[w->n_crossing].triangle = t;
+	w->crossing[w->n_crossing].t_in     = t_in;
+	w->crossing[w->n_crossing].t_out    = t_out;
+	w->n_crossing++;
+}
+
+/* Line of the edge facing c: a + t d meets it at t = *num / *den, going
+   out of the triangle if *den > 0 */
+static void clip_edge(corner_table_t *ct, uint32_t c, point_t *a, double dx, double dy,
+                      double *num, double *den)
+{
+	point_t *u = ct->cloud + ct->v[CT_NEXT(c)], *w = ct->cloud + ct->v[CT_PREV(c)];
+	double nx = w->y - u->y, ny = u->x - w->x; /* Outward normal */
+
+	*num = nx * (u->x - a->x) + ny * (u->y - a->y);
+	*den = nx * dx + ny * dy;
+}
+
+/* The direction d is inside the angle of the triangle at corner c */
+static int in_wedge(corner_table_t *ct, uint32_t c, double dx, double dy)
+{
+	point_t *q = ct->cloud + ct->v[c], *x = ct->cloud + ct->v[CT_NEXT(c)], *y = ct->cloud + ct->v[CT_PREV(c)];
+
+	return ((x->x - q->x) * dy - (x->y - q->y) * dx >= 0 &&
+	        (y->x - q->x) * dy - (y->y - q->y) * dx <= 0);
+}
+
+/* Corner of the vertex of c in the triangle the direction d leaves it
+   through, NO_CORNER if it leaves the hull */
+static uint32_t pivot(corner_table_t *ct, uint32_t c, double dx, double dy)
+{
+	uint32_t start = c, oc;
+	int ccw;
+
+	/* Counterclockwise, then clockwise if the hull stops the turn */
+	for (ccw=1; ccw >= 0; ccw--) {
+		for (c = start; !in_wedge(ct, c, dx, dy); ) {
+			oc = ccw ? ct->o[CT_NEXT(c)] : ct->o[CT_PREV(c)];
+			if (oc == NO_CORNER) break;
+			c = ccw ? CT_NEXT(oc) : CT_PREV(oc);
+			if (c == start) return NO_CORNER; /* Rounding errors */
+		}
+		if (in_wedge(ct, c, dx, dy)) return c;
+	}
+	return NO_CORNER;
+}
+
+/* Corner of the extremity of the edge facing c on the line a + t d, if any */
+static uint32_t vertex_on_line(corner_table_t *ct, uint32_t c, point_t *a, double dx, double dy)
+{
+	point_t *p;
+	int k;
+
+	for (k=0, c = CT_NEXT(c); k < 2; k++, c = CT_NEXT(c)) {
+		p = ct->cloud + ct->v[c];
+		if ((p->x - a->x) * dy - (p->y - a->y) * dx == 0) return c;
+	}
+	return NO_CORNER;
+}
+
+/* Triangle containing p, or NO_CORNER with *c the hull edge p is beyond */
+static uint32_t walk_to(corner_table_t *ct, uint32_t t, point_t *p, uint32_t *c)
+{
+	int k;
+
+	for (;;) {
+		for (k=0; k < 3; k++) {
+			*c = 3*t + k;
+			if (is_counter_clockwise(ct->cloud + ct->v[CT_PREV(*c)], ct->cloud + ct->v[CT_NEXT(*c)], p))
+				break;
+		}
+		if (k == 3) return t;
+		if (ct->o[*c] == NO_CORNER) return NO_CORNER;
+		t = ct->o[*c] / 3;
+	}
+}
+
+/* Squared distance from p to the edge facing c */
+static double edge_distance(corner_table_t *ct, uint32_t c, point_t *p)
+{
+	point_t *u = ct->cloud + ct->v[CT_NEXT(c)], *w = ct->cloud + ct->v[CT_PREV(c)];
+	double ex = w->x - u->x, ey = w->y - u->y, s, x, y;
+
+	s = ((p->x - u->x) * ex + (p->y - u->y) * ey) / (ex*ex + ey*ey);
+	if (s < 0) s = 0;
+	if (s > 1) s = 1;
+	x = u->x + s * ex - p->x;
+	y = u->y + s * ey - p->y;
+	return x*x + y*y;
+}
+
+/* Corner facing the hull edge through which a segment starting outside of
+   the hull enters it, NO_CORNER if it misses it. *t_in is where it enters */
+static uint32_t enter_hull(traverse_batch_t *b, point_t *a, double dx, double dy, double *t_in)
+{
+	double t_enter = 0, t_exit = 1, num, den, t, dist, best = 0;
+	uint32_t i, first = NO_CORNER;
+	point_t p;
+
+	for (i=0; i < b->n_border; i++) {
+		clip_edge(b->ct, b->border[i], a, dx, dy, &num, &den);
+		if (den == 0) {
+			if (num < 0) return NO_CORNER; /* Parallel, outside */
+			continue;
+		}
+		t = num / den;
+		if (den < 0 && t > t_enter) t_enter = t;
+		else if (den > 0 && t < t_exit) t_exit = t;
+	}
+	if (t_enter == 0 || t_enter > t_exit) return NO_CORNER;
+
+	/* Hull edges on a line give the same t_enter: the one holding the point */
+	p.x = a->x + t_enter * dx;
+	p.y = a->y + t_enter * dy;
+	for (i=0; i < b->n_border; i++) {
+		clip_edge(b->ct, b->border[i], a, dx, dy, &num, &den);
+		if (den >= 0) continue;
+		dist = edge_distance(b->ct, b->border[i], &p);
+		if (first == NO_CORNER || dist < best) {
+			best  = dist;
+			first = b->border[i];
+		}
+	}
+
+	*t_in = t_enter;
+	return first;
+}
+
+static void traverse(traverse_worker_t *w, uint32_t i)
+{
+	traverse_batch_t *b = w->b;
+	corner_table_t *ct = b->ct;
+	point_t *a = b->from + i, *z = b->to + i;
+	double dx = z->x - a->x, dy = z->y - a->y, t_in = 0, t_out, num, den, t;
+	uint32_t tri, c, exit, from = NO_CORNER, steps;
+	int k;
+
+	b->worker[i] = (uint32_t)w->id;
+	b->offset[i] = w->n_crossing;
+	b->count[i]  = 0;
+
+	if ((tri = walk_to(ct, w->last, a, &c)) != NO_CORNER) {
+		w->last = tri;
+		if (dx == 0 && dy == 0) { /* A point */
+			add_crossing(w, tri, 0, 0);
+			b->count[i] = 1;
+			return;
+		}
+		for (k=0; k < 3; k++) {
+			if (ct->cloud[ct->v[3*tri+k]].x != a->x || ct->cloud[ct->v[3*tri+k]].y != a->y) continue;
+			if ((c = pivot(ct, 3*tri+k, dx, dy)) == NO_CORNER) return; /* Starts on the hull, going out */
+			tri = c / 3;
+			break;
+		}
+	}
+	else {
+		if ((c = enter_hull(b, a, dx, dy, &t_in)) == NO_CORNER) return;
+		tri = c / 3;
+		if ((c = vertex_on_line(ct, c, a, dx, dy)) != NO_CORNER) { /* Enters at a vertex */
+			if ((c = pivot(ct, c, dx, dy)) == NO_CORNER) return;
+			tri = c / 3;
+		}
+	}
+
+	for (steps=0; steps <= ct->n_triangles; steps++) {
+		/* First edge crossed going out, the way in left aside */
+		t_out = 0;
+		exit = NO_CORNER;
+		for (k=0; k < 3; k++) {
+			c = 3*tri + k;
+			if (c == from) continue;
+			clip_edge(ct, c, a, dx, dy, &num, &den);
+			if (den <= 0) continue;
+			t = num / den;
+			if (t < t_in) t = t_in;
+			if (exit == NO_CORNER || t < t_out) {
+				t_out = t;
+				exit = c;
+			}
+		}
+		if (exit == NO_CORNER) break; /* Rounding errors */
+
+		if (t_out > 1) t_out = 1;
+		if (t_out > t_in) add_crossing(w, tri, t_in, t_out);
+		if (t_out >= 1) break;
+		t_in = t_out;
+
+		if ((c = vertex_on_line(ct, exit, a, dx, dy)) != NO_CORNER) { /* Through a vertex */
+			if ((c = pivot(ct, c, dx, dy)) == NO_CORNER) break;
+			from = NO_CORNER;
+			tri  = c / 3;
+		}
+		else {
+			if ((from = ct->o[exit]) == NO_CORNER) break;
+			tri = from / 3;
+		}
+	}
+
+	b->count[i] = w->n_crossing - b->offset[i];
+}
+
+static void *traverse_worker(void *arg)
+{
+	traverse_worker_t *w = (traverse_worker_t *)arg;
+	int n = (int)w->b->n, first, i;
+
+	while ((first = __sync_fetch_and_add(&w->b->next, CHUNK)) < n)
+		for (i=first; i < first + CHUNK && i < n; i++)
+			traverse(w, w->b->order[i]);
+	return NULL;
+}
+
+traversal_t *traverse_segments(corner_table_t *ct, point_t *from, point_t *to, uint32_t n,
+                               int n_threads)
+{
+	traversal_t *r = (traversal_t *)traverse_alloc(sizeof(traversal_t));
+	traverse_worker_t *workers;
+	traverse_batch_t b;
+	pthread_t *threads;
+	uint32_t c, i;
+	int t;
+
+	if (n_threads < 1) n_threads = 1;
+	r->n_segments = n;
+	r->first = (uint32_t *)traverse_alloc((n+1) * sizeof(uint32_t));
+	r->first[0] = 0;
+	if (ct->n_triangles == 0) {
+		for (i=0; i < n; i++) r->first[i+1] = 0;
+		r->crossing = (crossing_t *)traverse_alloc(0);
+		return r;
+	}
+
+	b.ct   = ct;
+	b.from = from;
+	b.to   = to;
+	b.n    = n;
+	b.next = 0;
+	b.count  = (uint32_t *)traverse_alloc(n * sizeof(uint32_t));
+	b.worker = (uint32_t *)traverse_alloc(n * sizeof(uint32_t));
+	b.offset = (uint32_t *)traverse_alloc(n * sizeof(uint32_t));
+	b.order  = (uint32_t *)traverse_alloc(n * sizeof(uint32_t));
+	hilbert_order(from, n, b.order);
+	for (c=0, b.n_border=0; c < 3*ct->n_triangles; c++)
+		if (ct->o[c] == NO_CORNER) b.n_border++;
+	b.border = (uint32_t *)traverse_alloc(b.n_border * sizeof(uint32_t));
+	for (c=0, b.n_border=0; c < 3*ct->n_triangles; c++)
+		if (ct->o[c] == NO_CORNER) b.border[b.n_border++] = c;
+
+	workers = (traverse_worker_t *)traverse_alloc(n_threads * sizeof(traverse_worker_t));
+	threads = (pthread_t *)traverse_alloc(n_threads * sizeof(pthread_t));
+	for (t=0; t < n_threads; t++) {
+		workers[t].b            = &b;
+		workers[t].id           = t;
+		workers[t].last         = 0;
+		workers[t].crossing     = NULL;
+		workers[t].n_crossing   = 0;
+		workers[t].max_crossing = 0;
+		if (pthread_create(&threads[t], NULL, traverse_worker, &workers[t]) != 0) {
+			fprintf(stderr, "Unable to start traversal worker %d\n", t);
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (t=0; t < n_threads; t++) pthread_join(threads[t], NULL);
+
+	/* Segments in order */
+	for (i=0; i < n; i++) r->first[i+1] = r->first[i] + b.count[i];
+	r->crossing = (crossing_t *)traverse_alloc(r->first[n] * sizeof(crossing_t));
+	for (i=0; i < n; i++)
+		memcpy(r->crossing + r->first[i], workers[b.worker[i]].crossing + b.offset[i],
+		       b.count[i] * sizeof(crossing_t));
+
+	for (t=0; t < n_threads; t++) free(workers[t].crossing);
+	free(workers);
+	free(threads);
+	free(b.count);
+	free(b.worker);
+	free(b.offset);
+	free(b.order);
+	free(b.border);
+	return r;
+}
+
+void destroy_traversal(traversal_t *t)
+{
+	if (t == NULL) return;
+
+	free(t->first);
+	free(t->crossing);
+	free(t);
+}
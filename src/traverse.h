@@ -0,0 +1,25 @@
+/* Triangle crossed by a segment from a to b, between the points of
+   parameters t_in and t_out (a + t (b - a), 0 <= t_in <= t_out <= 1) */
+typedef struct {
+	uint32_t triangle;
+	double t_in;
+	double t_out;
+} crossing_t;
+
+/* Crossings of segment i, in order from its start, are crossing[first[i]]
+   to crossing[first[i+1]-1] */
+typedef struct {
+	uint32_t n_segments;
+	uint32_t *first;
+	crossing_t *crossing;
+} traversal_t;
+
+/* Triangles of ct crossed by each segment from[i] -> to[i]. The segments
+   are shared by n_threads workers. A ray is a segment going past the hull:
+   crossings stop where it leaves the hull. A segment costs the triangles it
+   crosses, plus the hull size if it starts outside of the hull. Memory
+   reads follow the mesh order: renumber_corner_table() first pays off on
+   large meshes */
+traversal_t *traverse_segments(corner_table_t *ct, point_t *from, point_t *to, uint32_t n,
+                               int n_threads);
+void destroy_traversal(traversal_t *t);
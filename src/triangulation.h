@@ -0,0 +1,36 @@
+/* One interface for all the engines: the triangulation is built by the
+   chosen engine, then kept as a corner table (ctable.h) indexing cloud */
+typedef enum {
+	ENGINE_AUTO,        /* choose_engine() */
+	ENGINE_LIST,        /* delaunay.c: triangle list */
+	ENGINE_SWEEPHULL,   /* sweephull.c: radial sweep */
+	ENGINE_QUADEDGE,    /* gb.c with the location hierarchy (hierarchy.c) */
+	ENGINE_CONCURRENT,  /* gb.c, points shared by threads (concurrent.c) */
+	ENGINE_SMALL        /* small.c: at most SMALL_MAX_POINTS points */
+} engine_t;
+
+typedef struct {
+	engine_t engine;    /* Engine that built the triangulation */
+	corner_table_t *ct;
+	uint32_t last;      /* Triangle found by the last location */
+} triangulation_t;
+
+/* Fastest engine for n points */
+engine_t choose_engine(int n);
+
+/* Delaunay triangulation of cloud (duplicates are left out), NULL if all
+   the points are collinear. cloud must stay until it is destroyed. The
+   quadedge engines use the global triangulation of gb.c and hierarchy.c,
+   and leave it empty: while it holds points (is_delaunay_started()) or a
+   checkpoint of the quadedges is kept, the sweep-hull replaces them
+   (t->engine tells) */
+triangulation_t *triangulate(point_t *cloud, int n, engine_t engine, int n_threads);
+void destroy_triangulation(triangulation_t *t);
+
+/* Triangle containing p (on its border included), NO_CORNER if p is
+   outside of the hull. Walks from the last triangle found: locations on
+   the same triangulation must not run at the same time */
+uint32_t locate_triangle(triangulation_t *t, point_t *p);
+
+/* Snapshot file (snapshot.h). Returns 0, or -1 with errno set */
+int export_triangulation(triangulation_t *t, const char *path);
@@ -1,6 +1,7 @@
 void set_circumcircle(triangle_t *t);
 double v_product(point_t *p1, point_t *p2, point_t *p3);
 int direct_direction(point_t *p1, point_t *p2, point_t *p3);
+int is_inside_segment (point_t *p0, point_t *p1, point_t *p2);
 int check_inclusion(point_t *p, triangle_t *t);
 double euclidian_distance(point_t *A, point_t *B);
 